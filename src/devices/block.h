@@ -53,6 +53,10 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_readv (struct block *, block_sector_t, void *const buffers[],
+                  size_t cnt);
+void block_writev (struct block *, block_sector_t,
+                   const void *const buffers[], size_t cnt);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
@@ -65,6 +69,14 @@ struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+
+    /* Optional: transfer CNT consecutive sectors, each to or from
+       its own buffer, as a single request.  If null, the block
+       layer falls back to one read or write per sector. */
+    void (*readv) (void *aux, block_sector_t, void *const buffers[],
+                   size_t cnt);
+    void (*writev) (void *aux, block_sector_t, const void *const buffers[],
+                    size_t cnt);
   };
 
 struct block *block_register (const char *name, enum block_type,
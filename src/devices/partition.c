@@ -317,8 +317,30 @@ partition_write (void *p_, block_sector_t sector, const void *buffer)
   block_write (p->block, p->start + sector, buffer);
 }
 
+/* Reads CNT sectors starting at SECTOR from partition P into
+   BUFFERS, one sector per buffer. */
+static void
+partition_readv (void *p_, block_sector_t sector, void *const buffers[],
+                 size_t cnt)
+{
+  struct partition *p = p_;
+  block_readv (p->block, p->start + sector, buffers, cnt);
+}
+
+/* Writes CNT sectors starting at SECTOR to partition P from
+   BUFFERS, one sector per buffer. */
+static void
+partition_writev (void *p_, block_sector_t sector,
+                  const void *const buffers[], size_t cnt)
+{
+  struct partition *p = p_;
+  block_writev (p->block, p->start + sector, buffers, cnt);
+}
+
 static struct block_operations partition_operations =
   {
     partition_read,
-    partition_write
+    partition_write,
+    partition_readv,
+    partition_writev
   };
@@ -9,6 +9,9 @@
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#ifdef VM
+#include "vm/frame.h"
+#endif
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -139,6 +142,9 @@ static void timer_interrupt(struct intr_frame* args UNUSED) {
   ticks++;
 
   thread_wake_sleeping(ticks);
+#ifdef VM
+  frame_tick(ticks);
+#endif
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
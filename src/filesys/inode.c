@@ -1,5 +1,6 @@
 #include "filesys/inode.h"
-#include <list.h>
+#include <hash.h>
+#include <ohash.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
@@ -28,11 +29,19 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
 }
 
+/* The part of an in-memory inode that identifies it in the open
+   inode set, so that lookups need not build a whole `struct inode'
+   (with its sector of disk data) on the stack. */
+struct inode_key
+  {
+    struct ohash_elem elem;             /* Element in open inode set. */
+    block_sector_t sector;              /* Sector number of disk location. */
+  };
+
 /* In-memory inode. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
-    block_sector_t sector;              /* Sector number of disk location. */
+    struct inode_key key;               /* Open inode set key. */
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
@@ -53,15 +62,34 @@ byte_to_sector (const struct inode *inode, off_t pos)
     return -1;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Set of open inodes, keyed by sector, so that opening a single
+   inode twice returns the same `struct inode'. */
+static struct ohash open_inodes;
+
+/* Returns a hash value for inode E. */
+static unsigned
+inode_hash (const struct ohash_elem *e, void *aux UNUSED)
+{
+  const struct inode_key *key = ohash_entry (e, struct inode_key, elem);
+  return hash_int (key->sector);
+}
+
+/* Returns true if inode A precedes inode B. */
+static bool
+inode_less (const struct ohash_elem *a, const struct ohash_elem *b,
+            void *aux UNUSED)
+{
+  const struct inode_key *key_a = ohash_entry (a, struct inode_key, elem);
+  const struct inode_key *key_b = ohash_entry (b, struct inode_key, elem);
+  return key_a->sector < key_b->sector;
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  if (!ohash_init (&open_inodes, inode_hash, inode_less, NULL))
+    PANIC ("inode_init: out of memory");
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -111,19 +139,18 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
+  struct ohash_elem *e;
   struct inode *inode;
+  struct inode_key key;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  key.sector = sector;
+  e = ohash_find (&open_inodes, &key.elem);
+  if (e != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
+      inode = ohash_entry (e, struct inode, key.elem);
+      inode_reopen (inode);
+      return inode; 
     }
 
   /* Allocate memory. */
@@ -132,12 +159,12 @@ inode_open (block_sector_t sector)
     return NULL;
 
   /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
-  inode->sector = sector;
+  inode->key.sector = sector;
+  ohash_insert (&open_inodes, &inode->key.elem);
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  block_read (fs_device, inode->key.sector, &inode->data);
   return inode;
 }
 
@@ -154,7 +181,7 @@ inode_reopen (struct inode *inode)
 block_sector_t
 inode_get_inumber (const struct inode *inode)
 {
-  return inode->sector;
+  return inode->key.sector;
 }
 
 /* Closes INODE and writes it to disk.
@@ -170,13 +197,13 @@ inode_close (struct inode *inode)
   /* Release resources if this was the last opener. */
   if (--inode->open_cnt == 0)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
+      /* Remove from open inode set and release lock. */
+      ohash_delete (&open_inodes, &inode->key.elem);
  
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
-          free_map_release (inode->sector, 1);
+          free_map_release (inode->key.sector, 1);
           free_map_release (inode->data.start,
                             bytes_to_sectors (inode->data.length)); 
         }
@@ -0,0 +1,42 @@
+#ifndef __LIB_FAULTSTAT_H
+#define __LIB_FAULTSTAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Page fault statistics, as reported by the faultstat system call
+   and printed at shutdown. */
+
+/* What a page fault turned out to be. */
+enum fault_class
+  {
+    FAULT_STACK,                /* Stack growth or a fresh stack page,
+                                   or a fresh anonymous (heap) page. */
+    FAULT_FILE,                 /* Lazy load of an executable's page. */
+    FAULT_MMAP,                 /* First touch of a mapped file page. */
+    FAULT_SWAP,                 /* Page read back from swap. */
+    FAULT_COW,                  /* Write to a shared or zero-frame page. */
+    FAULT_INVALID,              /* Bad access; the process is killed. */
+    FAULT_CLASS_CNT             /* Number of classes. */
+  };
+
+/* Latency histogram buckets.  Bucket I counts faults that took
+   from 2**I up to 2**(I+1) - 1 CPU cycles to handle. */
+#define FAULTSTAT_BUCKET_CNT 32
+
+/* Faults of one class. */
+struct faultstat_class
+  {
+    size_t cnt;                 /* Faults handled. */
+    uint64_t cycles;            /* Total cycles spent handling them. */
+    size_t hist[FAULTSTAT_BUCKET_CNT]; /* Log2 cycle histogram. */
+  };
+
+/* Snapshot of page fault statistics. */
+struct faultstat
+  {
+    struct faultstat_class self[FAULT_CLASS_CNT]; /* Calling process. */
+    struct faultstat_class all[FAULT_CLASS_CNT];  /* Since boot. */
+  };
+
+#endif /* lib/faultstat.h */
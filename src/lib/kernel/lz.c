@@ -0,0 +1,201 @@
+#include "lz.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* Shortest match worth a back-reference. */
+#define MIN_MATCH 4
+
+/* Largest back-reference distance. */
+#define MAX_OFFSET 65535
+
+/* Length values stored in a token nibble before extension bytes. */
+#define RUN_MASK 15
+
+/* Reads 4 bytes at P, which need not be aligned. */
+static inline uint32_t
+read32 (const uint8_t *p)
+{
+  uint32_t v;
+  memcpy (&v, p, sizeof v);
+  return v;
+}
+
+/* Hashes the 4-byte sequence V into the match table. */
+static inline unsigned
+hash32 (uint32_t v)
+{
+  return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Appends the extension bytes for length LEN, which has already
+   been clipped to RUN_MASK in the token, at *OP.  Returns false
+   if that would pass END. */
+static bool
+put_length (uint8_t **op, uint8_t *end, size_t len)
+{
+  len -= RUN_MASK;
+  while (len >= 255)
+    {
+      if (*op >= end)
+        return false;
+      *(*op)++ = 255;
+      len -= 255;
+    }
+  if (*op >= end)
+    return false;
+  *(*op)++ = len;
+  return true;
+}
+
+/* Appends a sequence to *OP: LIT_LEN literals from LIT, then, if
+   MATCH_LEN is nonzero, a back-reference of MATCH_LEN bytes at
+   distance OFFSET.  Returns false if it does not fit before END. */
+static bool
+put_sequence (uint8_t **op, uint8_t *end, const uint8_t *lit,
+              size_t lit_len, size_t offset, size_t match_len)
+{
+  uint8_t *token = *op;
+  size_t ml = match_len ? match_len - MIN_MATCH : 0;
+
+  if (*op >= end)
+    return false;
+  *token = (lit_len < RUN_MASK ? lit_len : RUN_MASK) << 4;
+  *token |= ml < RUN_MASK ? ml : RUN_MASK;
+  (*op)++;
+
+  if (lit_len >= RUN_MASK && !put_length (op, end, lit_len))
+    return false;
+  if ((size_t) (end - *op) < lit_len)
+    return false;
+  memcpy (*op, lit, lit_len);
+  *op += lit_len;
+
+  if (match_len == 0)
+    return true;
+  if (end - *op < 2)
+    return false;
+  *(*op)++ = offset;
+  *(*op)++ = offset >> 8;
+  if (ml >= RUN_MASK && !put_length (op, end, ml))
+    return false;
+  return true;
+}
+
+/* Compresses the SRC_LEN bytes at SRC into DST, which has room
+   for DST_CAP bytes.  WORK must point to LZ_WORK_SIZE bytes of
+   scratch memory.  Returns the compressed size, or 0 if the
+   result would not fit in DST_CAP bytes. */
+size_t
+lz_compress (const void *src_, size_t src_len,
+             void *dst_, size_t dst_cap, void *work)
+{
+  const uint8_t *src = src_;
+  uint8_t *dst = dst_;
+  uint8_t *op = dst;
+  uint8_t *end = dst + dst_cap;
+  uint16_t *table = work;
+  size_t ip = 0;
+  size_t anchor = 0;
+
+  ASSERT (src_len <= LZ_MAX_INPUT);
+
+  /* Table entries hold position + 1, so that 0 means empty. */
+  memset (table, 0, LZ_WORK_SIZE);
+
+  while (ip + MIN_MATCH <= src_len)
+    {
+      uint32_t seq = read32 (src + ip);
+      unsigned h = hash32 (seq);
+      size_t cand = table[h];
+
+      table[h] = ip + 1;
+      if (cand != 0 && ip - (cand - 1) <= MAX_OFFSET
+          && read32 (src + cand - 1) == seq)
+        {
+          size_t match = cand - 1;
+          size_t len = MIN_MATCH;
+
+          while (ip + len < src_len && src[match + len] == src[ip + len])
+            len++;
+          if (!put_sequence (&op, end, src + anchor, ip - anchor,
+                             ip - match, len))
+            return 0;
+          ip += len;
+          anchor = ip;
+        }
+      else
+        ip++;
+    }
+
+  if (!put_sequence (&op, end, src + anchor, src_len - anchor, 0, 0))
+    return 0;
+  return op - dst;
+}
+
+/* Reads a length extension at *IP, adding it to *LEN.  Returns
+   false if the input ends first. */
+static bool
+get_length (const uint8_t **ip, const uint8_t *end, size_t *len)
+{
+  uint8_t b;
+
+  do
+    {
+      if (*ip >= end)
+        return false;
+      b = *(*ip)++;
+      *len += b;
+    }
+  while (b == 255);
+  return true;
+}
+
+/* Decompresses the SRC_LEN bytes at SRC, as produced by
+   lz_compress(), into DST, which has room for DST_CAP bytes.
+   Returns the decompressed size, or 0 if the input is corrupt or
+   does not fit. */
+size_t
+lz_decompress (const void *src_, size_t src_len, void *dst_, size_t dst_cap)
+{
+  const uint8_t *ip = src_;
+  const uint8_t *end = ip + src_len;
+  uint8_t *dst = dst_;
+  uint8_t *op = dst;
+  uint8_t *op_end = dst + dst_cap;
+
+  while (ip < end)
+    {
+      uint8_t token = *ip++;
+      size_t lit_len = token >> 4;
+      size_t match_len = token & RUN_MASK;
+      size_t offset;
+
+      /* Literals. */
+      if (lit_len == RUN_MASK && !get_length (&ip, end, &lit_len))
+        return 0;
+      if ((size_t) (end - ip) < lit_len || (size_t) (op_end - op) < lit_len)
+        return 0;
+      memcpy (op, ip, lit_len);
+      ip += lit_len;
+      op += lit_len;
+      if (ip == end)
+        break;
+
+      /* Back-reference.  It may overlap its own output, so copy
+         byte by byte. */
+      if (end - ip < 2)
+        return 0;
+      offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      if (match_len == RUN_MASK && !get_length (&ip, end, &match_len))
+        return 0;
+      match_len += MIN_MATCH;
+      if (offset == 0 || offset > (size_t) (op - dst)
+          || (size_t) (op_end - op) < match_len)
+        return 0;
+      for (; match_len > 0; match_len--, op++)
+        *op = op[-offset];
+    }
+  return op - dst;
+}
@@ -0,0 +1,34 @@
+#ifndef __LIB_KERNEL_LZ_H
+#define __LIB_KERNEL_LZ_H
+
+/* Fast LZ77-family compressor.
+
+   The format follows LZ4's block format in spirit: the output is
+   a series of sequences, each a run of literal bytes followed by
+   a back-reference (2-byte offset, length of at least 4) into
+   the data already produced.  A token byte holds both lengths,
+   4 bits each, and lengths of 15 or more continue in following
+   bytes of 255 plus a final byte.  The last sequence has
+   literals only.
+
+   Matches are found with a single-probe hash table over 4-byte
+   prefixes, so compression is a single pass with no searching.
+   It trades ratio for speed, which is the right trade when the
+   alternative is a PIO disk transfer. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Largest input lz_compress() accepts. */
+#define LZ_MAX_INPUT 65535
+
+/* Bytes of scratch memory lz_compress() needs. */
+#define LZ_HASH_BITS 12
+#define LZ_WORK_SIZE (sizeof (uint16_t) << LZ_HASH_BITS)
+
+size_t lz_compress (const void *src, size_t src_len,
+                    void *dst, size_t dst_cap, void *work);
+size_t lz_decompress (const void *src, size_t src_len,
+                      void *dst, size_t dst_cap);
+
+#endif /* lib/kernel/lz.h */
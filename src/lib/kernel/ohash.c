@@ -0,0 +1,493 @@
+/* Open-addressing hash table.
+
+   See ohash.h for basic information. */
+
+#include "ohash.h"
+#include "../debug.h"
+#include "threads/malloc.h"
+
+/* Marks a slot of the old array that no longer holds an element
+   because it was moved to the new array or deleted.  Unlike an
+   empty slot, it does not end a probe sequence, so elements
+   further along the same run can still be found. */
+static struct ohash_elem vacated;
+#define VACATED (&vacated)
+
+/* Maximum load factor, as a fraction: grow when more than
+   MAX_LOAD_NUM / MAX_LOAD_DEN of the slots would be in use. */
+#define MAX_LOAD_NUM 3
+#define MAX_LOAD_DEN 4
+
+/* Number of old slots moved to the new array per insertion or
+   deletion while an incremental rehash is in progress.  With a
+   maximum load of 3/4 and a doubling growth step, this is large
+   enough that the new array stays below half full until the old
+   one is drained. */
+#define MIGRATE_STEP 8
+
+/* Initial number of slots. */
+#define MIN_SLOT_CNT 8
+
+static struct ohash_slot *alloc_slots (size_t slot_cnt);
+static bool elems_equal (struct ohash *, struct ohash_elem *,
+                         struct ohash_elem *);
+static struct ohash_slot *find_slot (struct ohash *, struct ohash_slot *,
+                                     size_t slot_cnt, unsigned hash,
+                                     struct ohash_elem *);
+static struct ohash_slot *lookup (struct ohash *, unsigned hash,
+                                  struct ohash_elem *, bool *in_old);
+static void insert_slot (struct ohash_slot *, size_t slot_cnt,
+                         unsigned hash, struct ohash_elem *);
+static void remove_slot (struct ohash_slot *, size_t slot_cnt,
+                         struct ohash_slot *);
+static void grow (struct ohash *);
+static void migrate (struct ohash *, size_t step);
+
+/* Initializes hash table H to compute hash values using HASH and
+   compare hash elements using LESS, given auxiliary data AUX. */
+bool
+ohash_init (struct ohash *h,
+            ohash_hash_func *hash, ohash_less_func *less, void *aux)
+{
+  h->elem_cnt = 0;
+  h->slot_cnt = MIN_SLOT_CNT;
+  h->slots = alloc_slots (h->slot_cnt);
+  h->old_slot_cnt = 0;
+  h->old_slots = NULL;
+  h->migrate_idx = 0;
+  h->hash = hash;
+  h->less = less;
+  h->aux = aux;
+
+  return h->slots != NULL;
+}
+
+/* Removes all the elements from H.
+
+   If DESTRUCTOR is non-null, then it is called for each element
+   in the hash.  DESTRUCTOR may, if appropriate, deallocate the
+   memory used by the hash element.  However, modifying hash
+   table H while ohash_clear() is running, using any of the
+   functions ohash_clear(), ohash_destroy(), ohash_insert(), or
+   ohash_delete(), yields undefined behavior, whether done in
+   DESTRUCTOR or elsewhere. */
+void
+ohash_clear (struct ohash *h, ohash_action_func *destructor)
+{
+  size_t i;
+
+  for (i = 0; i < h->slot_cnt; i++)
+    {
+      struct ohash_elem *e = h->slots[i].elem;
+      h->slots[i].elem = NULL;
+      if (destructor != NULL && e != NULL)
+        destructor (e, h->aux);
+    }
+
+  if (h->old_slots != NULL)
+    {
+      for (i = h->migrate_idx; i < h->old_slot_cnt; i++)
+        {
+          struct ohash_elem *e = h->old_slots[i].elem;
+          if (destructor != NULL && e != NULL && e != VACATED)
+            destructor (e, h->aux);
+        }
+      free (h->old_slots);
+      h->old_slots = NULL;
+      h->old_slot_cnt = 0;
+      h->migrate_idx = 0;
+    }
+
+  h->elem_cnt = 0;
+}
+
+/* Destroys hash table H.
+
+   If DESTRUCTOR is non-null, then it is first called for each
+   element in the hash.  DESTRUCTOR may, if appropriate,
+   deallocate the memory used by the hash element.  However,
+   modifying hash table H while ohash_clear() is running, using
+   any of the functions ohash_clear(), ohash_destroy(),
+   ohash_insert(), or ohash_delete(), yields undefined behavior,
+   whether done in DESTRUCTOR or elsewhere. */
+void
+ohash_destroy (struct ohash *h, ohash_action_func *destructor)
+{
+  ohash_clear (h, destructor);
+  free (h->slots);
+  h->slots = NULL;
+  h->slot_cnt = 0;
+}
+
+/* Inserts NEW into hash table H and returns a null pointer, if
+   no equal element is already in the table.
+   If an equal element is already in the table, returns it
+   without inserting NEW. */
+struct ohash_elem *
+ohash_insert (struct ohash *h, struct ohash_elem *new)
+{
+  unsigned hash = h->hash (new, h->aux);
+  bool in_old;
+  struct ohash_slot *s = lookup (h, hash, new, &in_old);
+
+  if (s != NULL)
+    return s->elem;
+
+  if (h->old_slots != NULL)
+    migrate (h, MIGRATE_STEP);
+  if ((h->elem_cnt + 1) * MAX_LOAD_DEN > h->slot_cnt * MAX_LOAD_NUM)
+    grow (h);
+
+  new->hash = hash;
+  insert_slot (h->slots, h->slot_cnt, hash, new);
+  h->elem_cnt++;
+  return NULL;
+}
+
+/* Finds and returns an element equal to E in hash table H, or a
+   null pointer if no equal element exists in the table.  Never
+   modifies H, so it is safe to call while iterating. */
+struct ohash_elem *
+ohash_find (struct ohash *h, struct ohash_elem *e)
+{
+  bool in_old;
+  struct ohash_slot *s = lookup (h, h->hash (e, h->aux), e, &in_old);
+
+  return s != NULL ? s->elem : NULL;
+}
+
+/* Finds, removes, and returns an element equal to E in hash
+   table H.  Returns a null pointer if no equal element existed
+   in the table.
+
+   If the elements of the hash table are dynamically allocated,
+   or own resources that are, then it is the caller's
+   responsibility to deallocate them. */
+struct ohash_elem *
+ohash_delete (struct ohash *h, struct ohash_elem *e)
+{
+  bool in_old;
+  struct ohash_slot *s = lookup (h, h->hash (e, h->aux), e, &in_old);
+  struct ohash_elem *found;
+
+  if (s == NULL)
+    return NULL;
+
+  found = s->elem;
+  if (!in_old)
+    remove_slot (h->slots, h->slot_cnt, s);
+  else
+    {
+      /* Shifting elements of a partially drained array could
+         move them across its vacated prefix, so just vacate the
+         slot; the array is going away anyway. */
+      s->elem = VACATED;
+    }
+  h->elem_cnt--;
+
+  if (h->old_slots != NULL)
+    migrate (h, MIGRATE_STEP);
+  return found;
+}
+
+/* Calls ACTION for each element in hash table H in arbitrary
+   order.
+   Modifying hash table H while ohash_apply() is running, using
+   any of the functions ohash_clear(), ohash_destroy(),
+   ohash_insert(), or ohash_delete(), yields undefined behavior,
+   whether done from ACTION or elsewhere. */
+void
+ohash_apply (struct ohash *h, ohash_action_func *action)
+{
+  struct ohash_iterator i;
+
+  ASSERT (action != NULL);
+
+  ohash_first (&i, h);
+  while (ohash_next (&i))
+    action (ohash_cur (&i), h->aux);
+}
+
+/* Initializes I for iterating hash table H.
+
+   Iteration idiom:
+
+      struct ohash_iterator i;
+
+      ohash_first (&i, h);
+      while (ohash_next (&i))
+        {
+          struct foo *f = ohash_entry (ohash_cur (&i), struct foo, elem);
+          ...do something with f...
+        }
+
+   Modifying hash table H during iteration, using any of the
+   functions ohash_clear(), ohash_destroy(), ohash_insert(), or
+   ohash_delete(), invalidates all iterators. */
+void
+ohash_first (struct ohash_iterator *i, struct ohash *h)
+{
+  ASSERT (i != NULL);
+  ASSERT (h != NULL);
+
+  i->hash = h;
+  i->in_old = false;
+  i->idx = 0;
+  i->elem = NULL;
+}
+
+/* Advances I to the next element in the hash table and returns
+   it.  Returns a null pointer if no elements are left.  Elements
+   are returned in arbitrary order.
+
+   Modifying a hash table H during iteration, using any of the
+   functions ohash_clear(), ohash_destroy(), ohash_insert(), or
+   ohash_delete(), invalidates all iterators. */
+struct ohash_elem *
+ohash_next (struct ohash_iterator *i)
+{
+  struct ohash *h;
+
+  ASSERT (i != NULL);
+
+  h = i->hash;
+  i->elem = NULL;
+  while (i->elem == NULL)
+    {
+      struct ohash_elem *e;
+
+      /* Walk the current array first, then the undrained part of
+         the old one. */
+      if (!i->in_old && i->idx >= h->slot_cnt)
+        {
+          if (h->old_slots == NULL)
+            break;
+          i->in_old = true;
+          i->idx = h->migrate_idx;
+        }
+      if (i->in_old && i->idx >= h->old_slot_cnt)
+        break;
+
+      e = (i->in_old ? h->old_slots : h->slots)[i->idx++].elem;
+      if (e != NULL && e != VACATED)
+        i->elem = e;
+    }
+
+  return i->elem;
+}
+
+/* Returns the current element in the hash table iteration, or a
+   null pointer at the end of the table.  Undefined behavior
+   after calling ohash_first() but before ohash_next(). */
+struct ohash_elem *
+ohash_cur (struct ohash_iterator *i)
+{
+  return i->elem;
+}
+
+/* Returns the number of elements in H. */
+size_t
+ohash_size (struct ohash *h)
+{
+  return h->elem_cnt;
+}
+
+/* Returns true if H contains no elements, false otherwise. */
+bool
+ohash_empty (struct ohash *h)
+{
+  return h->elem_cnt == 0;
+}
+
+/* Returns how far the element cached in slot IDX of an array
+   with SLOT_CNT slots has been displaced from its home slot. */
+static inline size_t
+probe_distance (size_t idx, unsigned hash, size_t slot_cnt)
+{
+  return (idx - (hash & (slot_cnt - 1))) & (slot_cnt - 1);
+}
+
+/* Allocates an array of SLOT_CNT empty slots, or returns a null
+   pointer if memory is exhausted. */
+static struct ohash_slot *
+alloc_slots (size_t slot_cnt)
+{
+  struct ohash_slot *slots = malloc (sizeof *slots * slot_cnt);
+  size_t i;
+
+  if (slots != NULL)
+    for (i = 0; i < slot_cnt; i++)
+      slots[i].elem = NULL;
+  return slots;
+}
+
+/* Returns true if A and B compare equal in H. */
+static bool
+elems_equal (struct ohash *h, struct ohash_elem *a, struct ohash_elem *b)
+{
+  return !h->less (a, b, h->aux) && !h->less (b, a, h->aux);
+}
+
+/* Searches the SLOT_CNT slots of SLOTS (in hash table H) for an
+   element equal to E, whose hash value is HASH.  Returns its
+   slot if found or a null pointer otherwise. */
+static struct ohash_slot *
+find_slot (struct ohash *h, struct ohash_slot *slots, size_t slot_cnt,
+           unsigned hash, struct ohash_elem *e)
+{
+  size_t mask = slot_cnt - 1;
+  size_t idx = hash & mask;
+  size_t dist;
+
+  for (dist = 0; dist < slot_cnt; dist++, idx = (idx + 1) & mask)
+    {
+      struct ohash_slot *s = &slots[idx];
+
+      if (s->elem == NULL)
+        return NULL;
+      if (s->elem == VACATED)
+        continue;
+
+      /* Robin Hood invariant: had E been inserted, it would have
+         displaced any element closer to its own home than E is
+         to E's. */
+      if (probe_distance (idx, s->hash, slot_cnt) < dist)
+        return NULL;
+      if (s->hash == hash && elems_equal (h, s->elem, e))
+        return s;
+    }
+  return NULL;
+}
+
+/* Searches both arrays of H for an element equal to E, whose
+   hash value is HASH.  Returns its slot, setting *IN_OLD to
+   whether the slot belongs to the old array, or returns a null
+   pointer if there is no such element. */
+static struct ohash_slot *
+lookup (struct ohash *h, unsigned hash, struct ohash_elem *e, bool *in_old)
+{
+  struct ohash_slot *s = find_slot (h, h->slots, h->slot_cnt, hash, e);
+
+  *in_old = false;
+  if (s == NULL && h->old_slots != NULL)
+    {
+      s = find_slot (h, h->old_slots, h->old_slot_cnt, hash, e);
+      *in_old = true;
+    }
+  return s;
+}
+
+/* Inserts E, whose hash value is HASH, into the SLOT_CNT slots
+   of SLOTS, which must have at least one empty slot and no
+   vacated ones. */
+static void
+insert_slot (struct ohash_slot *slots, size_t slot_cnt,
+             unsigned hash, struct ohash_elem *e)
+{
+  size_t mask = slot_cnt - 1;
+  size_t idx = hash & mask;
+  size_t dist = 0;
+  struct ohash_slot cur;
+
+  cur.hash = hash;
+  cur.elem = e;
+  for (;;)
+    {
+      struct ohash_slot *s = &slots[idx];
+      size_t s_dist;
+
+      if (s->elem == NULL)
+        {
+          *s = cur;
+          return;
+        }
+
+      /* Take the slot from an element that is closer to home,
+         and carry on inserting that one instead. */
+      s_dist = probe_distance (idx, s->hash, slot_cnt);
+      if (s_dist < dist)
+        {
+          struct ohash_slot tmp = *s;
+          *s = cur;
+          cur = tmp;
+          dist = s_dist;
+        }
+
+      idx = (idx + 1) & mask;
+      dist++;
+    }
+}
+
+/* Removes slot S from the SLOT_CNT slots of SLOTS by shifting
+   the rest of its probe run back by one. */
+static void
+remove_slot (struct ohash_slot *slots, size_t slot_cnt, struct ohash_slot *s)
+{
+  size_t mask = slot_cnt - 1;
+  size_t idx = s - slots;
+
+  for (;;)
+    {
+      size_t next = (idx + 1) & mask;
+      struct ohash_slot *n = &slots[next];
+
+      if (n->elem == NULL || probe_distance (next, n->hash, slot_cnt) == 0)
+        {
+          slots[idx].elem = NULL;
+          return;
+        }
+      slots[idx] = *n;
+      idx = next;
+    }
+}
+
+/* Starts an incremental rehash of H into an array twice as
+   large.  If that array cannot be allocated, keeps using the
+   current one for as long as it has room, which only makes
+   accesses slower. */
+static void
+grow (struct ohash *h)
+{
+  struct ohash_slot *new_slots;
+
+  /* Only one rehash at a time. */
+  if (h->old_slots != NULL)
+    migrate (h, h->old_slot_cnt);
+
+  new_slots = alloc_slots (h->slot_cnt * 2);
+  if (new_slots == NULL)
+    {
+      if (h->elem_cnt + 1 >= h->slot_cnt)
+        PANIC ("ohash: out of memory growing table");
+      return;
+    }
+
+  h->old_slots = h->slots;
+  h->old_slot_cnt = h->slot_cnt;
+  h->migrate_idx = 0;
+  h->slots = new_slots;
+  h->slot_cnt *= 2;
+}
+
+/* Moves up to STEP slots of H's old array into the current one,
+   freeing the old array once it has been drained. */
+static void
+migrate (struct ohash *h, size_t step)
+{
+  while (step-- > 0 && h->migrate_idx < h->old_slot_cnt)
+    {
+      struct ohash_slot *s = &h->old_slots[h->migrate_idx++];
+
+      if (s->elem != NULL && s->elem != VACATED)
+        insert_slot (h->slots, h->slot_cnt, s->hash, s->elem);
+      s->elem = VACATED;
+    }
+
+  if (h->migrate_idx >= h->old_slot_cnt)
+    {
+      free (h->old_slots);
+      h->old_slots = NULL;
+      h->old_slot_cnt = 0;
+      h->migrate_idx = 0;
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef __LIB_KERNEL_OHASH_H
+#define __LIB_KERNEL_OHASH_H
+
+/* Open-addressing hash table.
+
+   This is an alternative to the chained table in hash.h for
+   tables that sit on hot paths, such as the supplemental page
+   table consulted on every page fault.
+
+   The table is a single array of slots.  Each slot holds the
+   element's cached hash value and a pointer to the element, so
+   a probe sequence walks consecutive memory and only touches an
+   element when the cached hash already matches.  Collisions are
+   resolved with Robin Hood linear probing: an element that has
+   travelled further from its home slot steals the slot of one
+   that has travelled less, which keeps probe sequences short
+   and lets unsuccessful searches stop early.  Deletion shifts
+   the following elements back instead of leaving tombstones.
+
+   Growing the table does not rehash everything at once.
+   Instead, a larger array is allocated and the old one is kept
+   around; every later insertion or deletion moves a few old
+   slots over, and searches consult both arrays until the old
+   one is drained.  (Slots of the old array are only ever
+   marked vacated, never shifted.)  This spreads the cost of a
+   resize across many operations rather than charging it all to
+   one unlucky caller.
+
+   Like hash.h, the table is intrusive: each structure that can
+   be in an ohash embeds a struct ohash_elem, and ohash_entry()
+   converts back to the containing structure.  The table never
+   allocates memory per element. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Open-addressing hash element. */
+struct ohash_elem
+  {
+    unsigned hash;              /* Hash value, cached at insertion. */
+  };
+
+/* Converts pointer to hash element OHASH_ELEM into a pointer to
+   the structure that OHASH_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the hash element. */
+#define ohash_entry(OHASH_ELEM, STRUCT, MEMBER)                 \
+        ((STRUCT *) ((uint8_t *) &(OHASH_ELEM)->hash            \
+                     - offsetof (STRUCT, MEMBER.hash)))
+
+/* Computes and returns the hash value for hash element E, given
+   auxiliary data AUX. */
+typedef unsigned ohash_hash_func (const struct ohash_elem *e, void *aux);
+
+/* Compares the value of two hash elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool ohash_less_func (const struct ohash_elem *a,
+                              const struct ohash_elem *b,
+                              void *aux);
+
+/* Performs some operation on hash element E, given auxiliary
+   data AUX. */
+typedef void ohash_action_func (struct ohash_elem *e, void *aux);
+
+/* One slot of the table. */
+struct ohash_slot
+  {
+    unsigned hash;              /* Cached hash of ELEM. */
+    struct ohash_elem *elem;    /* Element, or null if the slot is empty. */
+  };
+
+/* Open-addressing hash table. */
+struct ohash
+  {
+    size_t elem_cnt;            /* Number of elements in table. */
+    size_t slot_cnt;            /* Number of slots, a power of 2. */
+    struct ohash_slot *slots;   /* Array of `slot_cnt' slots. */
+
+    /* Table being drained by an incremental rehash, if any. */
+    size_t old_slot_cnt;        /* Number of slots in OLD_SLOTS. */
+    struct ohash_slot *old_slots; /* Old array, or null. */
+    size_t migrate_idx;         /* Next old slot to move over. */
+
+    ohash_hash_func *hash;      /* Hash function. */
+    ohash_less_func *less;      /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `hash' and `less'. */
+  };
+
+/* An open-addressing hash table iterator. */
+struct ohash_iterator
+  {
+    struct ohash *hash;         /* The hash table. */
+    bool in_old;                /* Walking the old array? */
+    size_t idx;                 /* Index of next slot to visit. */
+    struct ohash_elem *elem;    /* Current hash element. */
+  };
+
+/* Basic life cycle. */
+bool ohash_init (struct ohash *, ohash_hash_func *, ohash_less_func *,
+                 void *aux);
+void ohash_clear (struct ohash *, ohash_action_func *);
+void ohash_destroy (struct ohash *, ohash_action_func *);
+
+/* Search, insertion, deletion. */
+struct ohash_elem *ohash_insert (struct ohash *, struct ohash_elem *);
+struct ohash_elem *ohash_find (struct ohash *, struct ohash_elem *);
+struct ohash_elem *ohash_delete (struct ohash *, struct ohash_elem *);
+
+/* Iteration. */
+void ohash_apply (struct ohash *, ohash_action_func *);
+void ohash_first (struct ohash_iterator *, struct ohash *);
+struct ohash_elem *ohash_next (struct ohash_iterator *);
+struct ohash_elem *ohash_cur (struct ohash_iterator *);
+
+/* Information. */
+size_t ohash_size (struct ohash *);
+bool ohash_empty (struct ohash *);
+
+#endif /* lib/kernel/ohash.h */
@@ -0,0 +1,63 @@
+#ifndef __LIB_MEMSTAT_H
+#define __LIB_MEMSTAT_H
+
+#include <stddef.h>
+
+/* Kernel memory usage statistics, as reported by the memstat
+   system call and the "memstat" kernel action. */
+
+/* Subsystems that page allocations are accounted to. */
+enum memstat_tag
+  {
+    MEMSTAT_OTHER,              /* Untagged allocations. */
+    MEMSTAT_THREADS,            /* Thread structures, kernel page tables. */
+    MEMSTAT_USERPROG,           /* Page directories, TSS, exec arguments. */
+    MEMSTAT_FILESYS,            /* File system buffers. */
+    MEMSTAT_VM,                 /* User frames and VM bookkeeping. */
+    MEMSTAT_MALLOC,             /* Arenas backing malloc(). */
+    MEMSTAT_TAG_CNT             /* Number of tags. */
+  };
+
+/* Maximum number of malloc() descriptors reported. */
+#define MEMSTAT_DESC_CNT 10
+
+/* Usage of one page allocator pool. */
+struct memstat_pool
+  {
+    size_t page_cnt;            /* Pages in the pool. */
+    size_t used_cnt;            /* Pages currently allocated. */
+    size_t peak_cnt;            /* Highest USED_CNT seen so far. */
+    size_t largest_free_run;    /* Longest run of contiguous free pages. */
+    size_t tag_cnt[MEMSTAT_TAG_CNT]; /* Allocated pages per subsystem. */
+  };
+
+/* Usage of one malloc() descriptor. */
+struct memstat_desc
+  {
+    size_t block_size;          /* Size of each block, 0 if unused entry. */
+    size_t used_cnt;            /* Blocks currently allocated. */
+    size_t arena_cnt;           /* Arenas (pages) backing this size. */
+  };
+
+/* Usage of the swap device, in page-sized slots. */
+struct memstat_swap
+  {
+    size_t slot_cnt;            /* Slots on the swap device. */
+    size_t used_cnt;            /* Slots currently holding a page. */
+    size_t peak_cnt;            /* Highest USED_CNT seen so far. */
+    size_t free_extent_cnt;     /* Runs of contiguous free slots. */
+    size_t largest_free_run;    /* Longest of those runs. */
+  };
+
+/* Snapshot of kernel memory usage. */
+struct memstat
+  {
+    struct memstat_pool kernel_pool;
+    struct memstat_pool user_pool;
+    struct memstat_desc descs[MEMSTAT_DESC_CNT];
+    size_t big_block_cnt;       /* Allocations too big for a descriptor. */
+    size_t big_page_cnt;        /* Pages backing those allocations. */
+    struct memstat_swap swap;
+  };
+
+#endif /* lib/memstat.h */
@@ -0,0 +1,19 @@
+#ifndef __LIB_MMAN_H
+#define __LIB_MMAN_H
+
+/* Advice for the madvise system call: how a process expects to
+   use a range of its memory. */
+enum madvise_advice
+  {
+    MADV_NORMAL,                /* No special treatment. */
+    MADV_RANDOM,                /* Random access: no readahead. */
+    MADV_SEQUENTIAL,            /* Sequential access: read ahead
+                                   aggressively, drop pages behind. */
+    MADV_WILLNEED,              /* Will be used soon: read it in now. */
+    MADV_DONTNEED               /* Not needed: drop it now.  Pages that
+                                   were written read back as their
+                                   initial contents, except mapped
+                                   files, which are written back. */
+  };
+
+#endif /* lib/mman.h */
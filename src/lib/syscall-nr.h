@@ -28,7 +28,17 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_MEMSTAT,                /* Report kernel memory usage. */
+    SYS_FORK,                   /* Duplicate this process. */
+    SYS_MADVISE,                /* Advise on expected use of memory. */
+    SYS_MSYNC,                  /* Write a mapping back to its file. */
+    SYS_FAULTSTAT,              /* Report page fault statistics. */
+    SYS_RSSLIMIT,               /* Set the resident-set limit. */
+    SYS_SBRK,                   /* Grow or shrink the heap. */
+    SYS_MMAP_ANON               /* Map anonymous memory. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -3,6 +3,11 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <faultstat.h>
+#include <memstat.h>
+#include <mman.h>
+#include <stddef.h>
+#include <stdint.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +50,14 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+bool memstat (struct memstat *);
+pid_t fork (void);
+bool madvise (void *addr, size_t length, int advice);
+bool msync (mapid_t);
+bool faultstat (struct faultstat *);
+size_t rsslimit (size_t pages);
+void *sbrk (intptr_t increment);
+mapid_t mmap_anon (void *addr, size_t length);
+
 #endif /* lib/user/syscall.h */
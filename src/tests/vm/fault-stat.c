@@ -0,0 +1,62 @@
+/* Reads and then writes every page of a bss array, and checks that
+   faultstat counts the zero-fill and copy faults this takes, and
+   that each class's histogram adds up to its count. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 8
+
+static char buf[PAGE_CNT * 4096] __attribute__ ((aligned (4096)));
+static struct faultstat before, after;
+
+static size_t
+hist_sum (const struct faultstat_class *c)
+{
+  size_t sum = 0;
+  int i;
+
+  for (i = 0; i < FAULTSTAT_BUCKET_CNT; i++)
+    sum += c->hist[i];
+  return sum;
+}
+
+void
+test_main (void)
+{
+  size_t i;
+  int c;
+
+  memset (&before, 0, sizeof before);
+  memset (&after, 0, sizeof after);
+
+  CHECK (faultstat (&before), "faultstat before");
+  for (i = 0; i < PAGE_CNT; i++)
+    if (buf[i * 4096] != 0)
+      fail ("page %zu does not read as zero", i);
+  for (i = 0; i < PAGE_CNT; i++)
+    buf[i * 4096] = 'x';
+  CHECK (faultstat (&after), "faultstat after");
+
+  if (after.self[FAULT_FILE].cnt < before.self[FAULT_FILE].cnt + PAGE_CNT)
+    fail ("reading %d bss pages took only %zu file faults", PAGE_CNT,
+          after.self[FAULT_FILE].cnt - before.self[FAULT_FILE].cnt);
+  if (after.self[FAULT_COW].cnt < before.self[FAULT_COW].cnt + PAGE_CNT)
+    fail ("writing %d zero pages took only %zu cow faults", PAGE_CNT,
+          after.self[FAULT_COW].cnt - before.self[FAULT_COW].cnt);
+  if (after.self[FAULT_INVALID].cnt != 0)
+    fail ("%zu invalid faults", after.self[FAULT_INVALID].cnt);
+
+  for (c = 0; c < FAULT_CLASS_CNT; c++)
+    {
+      if (after.all[c].cnt < after.self[c].cnt)
+        fail ("class %d: %zu faults in total but %zu in this process",
+              c, after.all[c].cnt, after.self[c].cnt);
+      if (hist_sum (&after.self[c]) != after.self[c].cnt)
+        fail ("class %d: histogram adds up to %zu, not %zu",
+              c, hist_sum (&after.self[c]), after.self[c].cnt);
+    }
+  msg ("fault counts add up");
+}
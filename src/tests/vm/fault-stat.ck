@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fault-stat) begin
+(fault-stat) faultstat before
+(fault-stat) faultstat after
+(fault-stat) fault counts add up
+(fault-stat) end
+EOF
+pass;
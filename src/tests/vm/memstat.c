@@ -0,0 +1,56 @@
+/* Checks that the memstat system call reports consistent kernel
+   memory usage, and that touching fresh pages of user memory is
+   reflected in the user pool. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 16
+
+static char buf[PAGE_CNT * 4096];
+
+/* Checks that the counters of POOL add up. */
+static void
+check_pool (const char *name, const struct memstat_pool *pool)
+{
+  size_t tagged = 0;
+  int i;
+
+  for (i = 0; i < MEMSTAT_TAG_CNT; i++)
+    tagged += pool->tag_cnt[i];
+  if (tagged != pool->used_cnt)
+    fail ("%s: %zu tagged pages but %zu in use", name, tagged, pool->used_cnt);
+  if (pool->used_cnt > pool->page_cnt || pool->peak_cnt < pool->used_cnt)
+    fail ("%s: bad usage %zu/%zu (peak %zu)", name, pool->used_cnt,
+          pool->page_cnt, pool->peak_cnt);
+  if (pool->largest_free_run > pool->page_cnt - pool->used_cnt)
+    fail ("%s: free run of %zu pages exceeds free pages", name,
+          pool->largest_free_run);
+}
+
+void
+test_main (void)
+{
+  struct memstat before, after;
+
+  CHECK (memstat (&before), "memstat before touching memory");
+  check_pool ("kernel pool", &before.kernel_pool);
+  check_pool ("user pool", &before.user_pool);
+
+  memset (buf, 0x5a, sizeof buf);
+
+  CHECK (memstat (&after), "memstat after touching memory");
+  check_pool ("kernel pool", &after.kernel_pool);
+  check_pool ("user pool", &after.user_pool);
+  if (after.swap.used_cnt > after.swap.slot_cnt
+      || after.swap.largest_free_run > after.swap.slot_cnt
+                                       - after.swap.used_cnt)
+    fail ("swap: bad usage %zu/%zu (largest free run %zu)",
+          after.swap.used_cnt, after.swap.slot_cnt,
+          after.swap.largest_free_run);
+  if (after.user_pool.tag_cnt[MEMSTAT_VM] < PAGE_CNT)
+    fail ("only %zu user pages accounted to vm",
+          after.user_pool.tag_cnt[MEMSTAT_VM]);
+}
@@ -0,0 +1,45 @@
+/* Writes to a file through a mapping and uses msync to write it
+   back while still mapped, then drops the mapped page with
+   madvise and checks that the data comes back from the file, by
+   way of a fresh page fault. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+
+static struct faultstat before, after;
+
+void
+test_main (void)
+{
+  int handle;
+  mapid_t map;
+  char buf[1024];
+
+  CHECK (create ("sample.txt", strlen (sample)), "create \"sample.txt\"");
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (handle, ACTUAL)) != MAP_FAILED, "mmap \"sample.txt\"");
+  memcpy (ACTUAL, sample, strlen (sample));
+  CHECK (msync (map), "msync \"sample.txt\"");
+
+  /* Read back via read(), with the file still mapped. */
+  read (handle, buf, strlen (sample));
+  CHECK (!memcmp (buf, sample, strlen (sample)),
+         "compare read data against written data");
+
+  /* Drop the page; touching it again faults it back in from the
+     file. */
+  CHECK (madvise (ACTUAL, 4096, MADV_DONTNEED), "madvise DONTNEED");
+  CHECK (faultstat (&before), "faultstat before");
+  CHECK (!memcmp (ACTUAL, sample, strlen (sample)),
+         "compare mapped data against written data");
+  CHECK (faultstat (&after), "faultstat after");
+  if (after.self[FAULT_MMAP].cnt <= before.self[FAULT_MMAP].cnt)
+    fail ("page was not dropped: no fault reading it back");
+  munmap (map);
+  close (handle);
+}
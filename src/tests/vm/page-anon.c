@@ -0,0 +1,47 @@
+/* Grows the heap with sbrk() and maps anonymous memory, checks that
+   both read as zeros and keep what is written, and that heap pages
+   given back with sbrk() read as zeros when the heap grows again. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 32
+#define MAP_ADDR ((char *) 0x10000000)
+
+static void
+check_fill (char *p, size_t page_cnt, const char *what)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt * 4096; i += 512)
+    if (p[i] != 0)
+      fail ("%s byte %zu is not zero", what, i);
+  for (i = 0; i < page_cnt; i++)
+    memset (p + i * 4096, i + 1, 4096);
+  for (i = 0; i < page_cnt; i++)
+    if (p[i * 4096] != (char) (i + 1)
+        || p[i * 4096 + 4095] != (char) (i + 1))
+      fail ("%s page %zu lost its contents", what, i);
+}
+
+void
+test_main (void)
+{
+  char *heap = sbrk (0);
+  mapid_t map;
+
+  CHECK (sbrk (PAGE_CNT * 4096) == heap, "sbrk %d pages", PAGE_CNT);
+  check_fill (heap, PAGE_CNT, "heap");
+  CHECK (sbrk (-PAGE_CNT * 4096) == heap + PAGE_CNT * 4096, "shrink heap");
+  CHECK (sbrk (-1) == (void *) -1, "shrinking below the heap fails");
+  CHECK (sbrk (4096) == heap, "sbrk 1 page");
+  check_fill (heap, 1, "regrown heap");
+
+  CHECK ((map = mmap_anon (MAP_ADDR, PAGE_CNT * 4096)) != MAP_FAILED,
+         "mmap_anon %d pages", PAGE_CNT);
+  check_fill (MAP_ADDR, PAGE_CNT, "mapping");
+  munmap (map);
+  msg ("munmap");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-anon) begin
+(page-anon) sbrk 32 pages
+(page-anon) shrink heap
+(page-anon) shrinking below the heap fails
+(page-anon) sbrk 1 page
+(page-anon) mmap_anon 32 pages
+(page-anon) munmap
+(page-anon) end
+EOF
+pass;
@@ -0,0 +1,56 @@
+/* Forks a process with a large data region, checks that the child
+   sees the parent's data, and that writes by either process are
+   not visible to the other (copy-on-write). */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (64 * 1024)
+
+static char buf[SIZE];
+
+/* Checks that every byte of buf is VALUE. */
+static void
+check_buf (char value, const char *who)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != value)
+      fail ("%s: byte %zu is %02hhx instead of %02hhx",
+            who, i, buf[i], value);
+}
+
+void
+test_main (void)
+{
+  volatile char stack_byte = 's';
+  pid_t child;
+  int status;
+
+  memset (buf, 'p', sizeof buf);
+
+  child = fork ();
+  if (child == 0)
+    {
+      check_buf ('p', "child");
+      memset (buf, 'c', sizeof buf);
+      stack_byte = 'c';
+      check_buf ('c', "child");
+      exit (81);
+    }
+  if (child == PID_ERROR)
+    fail ("fork failed");
+
+  /* Write half of the shared pages before the child finishes. */
+  memset (buf, 'q', sizeof buf / 2);
+  memset (buf, 'p', sizeof buf / 2);
+
+  status = wait (child);
+  CHECK (status == 81, "wait for child");
+  check_buf ('p', "parent");
+  if (stack_byte != 's')
+    fail ("parent's stack changed by child");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(page-fork) begin
+page-fork: exit(81)
+(page-fork) wait for child
+(page-fork) end
+page-fork: exit(0)
+EOF
+pass;
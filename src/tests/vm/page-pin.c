@@ -0,0 +1,41 @@
+/* Writes a large heap buffer to a file and reads it back into an
+   untouched anonymous mapping, with a resident-set limit well below
+   the buffer size, so that the system calls must fault in and pin
+   the buffer pages as they go. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 48
+#define SIZE (PAGE_CNT * 4096)
+#define MAP_ADDR ((char *) 0x10000000)
+
+void
+test_main (void)
+{
+  char *heap = sbrk (0);
+  mapid_t map;
+  size_t i;
+  int fd;
+
+  rsslimit (16);
+  CHECK (sbrk (SIZE) == heap, "sbrk %d pages", PAGE_CNT);
+  for (i = 0; i < SIZE; i++)
+    heap[i] = i % 251;
+  CHECK (create ("buffer", SIZE), "create \"buffer\"");
+  CHECK ((fd = open ("buffer")) > 1, "open \"buffer\"");
+  CHECK (write (fd, heap, SIZE) == SIZE, "write %d pages", PAGE_CNT);
+
+  CHECK ((map = mmap_anon (MAP_ADDR, SIZE)) != MAP_FAILED,
+         "mmap_anon %d pages", PAGE_CNT);
+  seek (fd, 0);
+  CHECK (read (fd, MAP_ADDR, SIZE) == SIZE, "read %d pages", PAGE_CNT);
+  for (i = 0; i < SIZE; i++)
+    if (MAP_ADDR[i] != (char) (i % 251))
+      fail ("byte %zu read back wrong", i);
+  msg ("contents match");
+  close (fd);
+  munmap (map);
+}
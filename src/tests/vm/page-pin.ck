@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-pin) begin
+(page-pin) sbrk 48 pages
+(page-pin) create "buffer"
+(page-pin) open "buffer"
+(page-pin) write 48 pages
+(page-pin) mmap_anon 48 pages
+(page-pin) read 48 pages
+(page-pin) contents match
+(page-pin) end
+EOF
+pass;
@@ -0,0 +1,35 @@
+/* Limits this process to a few resident frames, then writes and
+   checks an array several times that size, so that the process has
+   to swap out its own pages to keep going. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define RSS_LIMIT 16
+#define PAGE_CNT 64
+
+static char buf[PAGE_CNT * 4096] __attribute__ ((aligned (4096)));
+static struct faultstat stats;
+
+void
+test_main (void)
+{
+  size_t i;
+
+  CHECK (rsslimit (RSS_LIMIT) == 0, "rsslimit %d", RSS_LIMIT);
+  for (i = 0; i < PAGE_CNT; i++)
+    memset (buf + i * 4096, i + 1, 4096);
+  for (i = 0; i < PAGE_CNT; i++)
+    if (buf[i * 4096] != (char) (i + 1)
+        || buf[i * 4096 + 4095] != (char) (i + 1))
+      fail ("page %zu lost its contents", i);
+  msg ("%d pages check out", PAGE_CNT);
+
+  CHECK (faultstat (&stats), "faultstat");
+  if (stats.self[FAULT_SWAP].cnt == 0)
+    fail ("%d pages fit under a limit of %d frames without swapping",
+          PAGE_CNT, RSS_LIMIT);
+  CHECK (rsslimit (0) == RSS_LIMIT, "rsslimit 0");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-rss) begin
+(page-rss) rsslimit 16
+(page-rss) 64 pages check out
+(page-rss) faultstat
+(page-rss) rsslimit 0
+(page-rss) end
+EOF
+pass;
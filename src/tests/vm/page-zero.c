@@ -0,0 +1,36 @@
+/* Reads every page of a large bss array, which must read as zeros
+   without using up user frames, then writes to some of the pages
+   and checks that only those change. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 256
+#define WRITE_CNT 8
+
+static char buf[PAGE_CNT * 4096];
+
+void
+test_main (void)
+{
+  struct memstat before, after;
+  size_t i;
+
+  CHECK (memstat (&before), "memstat before reading");
+  for (i = 0; i < PAGE_CNT; i++)
+    if (buf[i * 4096] != 0)
+      fail ("page %zu does not read as zero", i);
+  CHECK (memstat (&after), "memstat after reading");
+  if (after.user_pool.used_cnt > before.user_pool.used_cnt + PAGE_CNT / 8)
+    fail ("reading %d zero pages used %zu user frames", PAGE_CNT,
+          after.user_pool.used_cnt - before.user_pool.used_cnt);
+
+  msg ("write to %d pages", WRITE_CNT);
+  for (i = 0; i < WRITE_CNT; i++)
+    buf[i * 4096 * 2] = 'x';
+  for (i = 0; i < PAGE_CNT; i++)
+    if (buf[i * 4096] != (i < WRITE_CNT * 2 && i % 2 == 0 ? 'x' : 0))
+      fail ("page %zu has wrong contents", i);
+}
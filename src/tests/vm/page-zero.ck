@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-zero) begin
+(page-zero) memstat before reading
+(page-zero) memstat after reading
+(page-zero) write to 8 pages
+(page-zero) end
+EOF
+pass;
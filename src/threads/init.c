@@ -51,17 +51,23 @@ uint32_t *init_page_dir;
 static bool format_filesys;
 
 /* -filesys, -scratch, -swap: Names of block devices to use,
-   overriding the defaults. */
+   overriding the defaults.  -swap takes a comma-separated list,
+   each name optionally followed by :PRIORITY. */
 static const char *filesys_bdev_name;
 static const char *scratch_bdev_name;
 #ifdef VM
-static const char *swap_bdev_name;
+static char *swap_bdev_names;
 #endif
 #endif /* FILESYS */
 
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
+#ifdef VM
+/* -zswap: Number of kernel pages for the compressed swap cache. */
+static size_t zswap_page_cnt;
+#endif
+
 static void bss_init(void);
 static void paging_init(void);
 
@@ -73,6 +79,10 @@ static void usage(void);
 #ifdef FILESYS
 static void locate_block_devices(void);
 static void locate_block_device(enum block_type, const char *name);
+#ifdef VM
+static void locate_swap_devices(void);
+static void add_swap_device(struct block *, int prio);
+#endif
 #endif
 
 int main(void) NO_RETURN;
@@ -129,7 +139,10 @@ int main(void) {
   ide_init();
   locate_block_devices();
   filesys_init(format_filesys);
-  SD_init();
+  SD_init(zswap_page_cnt);
+#ifdef VM
+  frame_kswapd_start();
+#endif
 #endif
 
   printf("Boot complete.\n");
@@ -153,16 +166,52 @@ static void bss_init(void) {
   memset(&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* CR4 flags.  See [IA32-v3a] 2.5 "Control Registers". */
+#define CR4_PSE 0x00000010      /* Page Size Extensions (4 MB pages). */
+#define CR4_PGE 0x00000080      /* Page Global Enable. */
+
+/* CPUID leaf 1 EDX feature flags. */
+#define CPUID_PSE 0x00000008    /* CR4.PSE is supported. */
+#define CPUID_PGE 0x00002000    /* CR4.PGE is supported. */
+
+/* Returns the feature flags that CPUID leaf 1 reports in EDX. */
+static uint32_t cpuid_features(void) {
+  uint32_t eax = 1, ebx, ecx, edx;
+  asm volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+  return edx;
+}
+
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports it, each whole 4 MB of RAM is mapped with a
+   single 4 MB PDE, which needs no page table and one TLB entry
+   instead of 1024.  Regions that need 4 kB granularity keep a page
+   table: the one holding the kernel text, so that it stays
+   read-only, and any that overlap the user pool, whose kernel
+   aliases the VM tracks per-page dirty bits on.
+
+   Kernel mappings are global (see pte_create_kernel()), so once
+   CR4.PGE is set they stay in the TLB across process switches. */
 static void paging_init(void) {
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  uint32_t features = cpuid_features();
+  bool pse = (features & CPUID_PSE) != 0;
+  size_t user_page_cnt;
+  char *user_start = palloc_user_pool(&user_page_cnt);
+  char *user_end = user_start + user_page_cnt * PGSIZE;
+
+  if (pse) {
+    uint32_t cr4;
+    asm volatile("movl %%cr4, %0" : "=r"(cr4));
+    asm volatile("movl %0, %%cr4" : : "r"(cr4 | CR4_PSE));
+  }
 
-  pd = init_page_dir = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+  pd = init_page_dir = palloc_get_page(PAL_ASSERT | PAL_ZERO | PAL_THREADS);
   pt = NULL;
   for (page = 0; page < init_ram_pages; page++) {
     uintptr_t paddr = page * PGSIZE;
@@ -171,8 +220,20 @@ static void paging_init(void) {
     size_t pte_idx = pt_no(vaddr);
     bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+    if (pse && pte_idx == 0 && page + PTSPAN / PGSIZE <= init_ram_pages) {
+      char *end = vaddr + PTSPAN;
+      bool has_text = vaddr < &_end_kernel_text && &_start < end;
+      bool has_user = vaddr < user_end && user_start < end;
+
+      if (!has_text && !has_user) {
+        pd[pde_idx] = pde_create_large(vaddr, true);
+        page += PTSPAN / PGSIZE - 1;
+        continue;
+      }
+    }
+
     if (pd[pde_idx] == 0) {
-      pt = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+      pt = palloc_get_page(PAL_ASSERT | PAL_ZERO | PAL_THREADS);
       pd[pde_idx] = pde_create(pt);
     }
 
@@ -185,6 +246,15 @@ static void paging_init(void) {
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
      of the Page Directory". */
   asm volatile("movl %0, %%cr3" : : "r"(vtop(init_page_dir)));
+
+  /* Only now that the boot page tables, which are not global, are
+     gone do we let kernel entries outlive CR3 loads.  Setting
+     CR4.PGE flushes the whole TLB. */
+  if (features & CPUID_PGE) {
+    uint32_t cr4;
+    asm volatile("movl %%cr4, %0" : "=r"(cr4));
+    asm volatile("movl %0, %%cr4" : : "r"(cr4 | CR4_PGE) : "memory");
+  }
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -241,7 +311,7 @@ static char **parse_options(char **argv) {
       scratch_bdev_name = value;
 #ifdef VM
     else if (!strcmp(name, "-swap"))
-      swap_bdev_name = value;
+      swap_bdev_names = value;
 #endif
 #endif
     else if (!strcmp(name, "-rs"))
@@ -251,6 +321,18 @@ static char **parse_options(char **argv) {
 #ifdef USERPROG
     else if (!strcmp(name, "-ul"))
       user_page_limit = atoi(value);
+#endif
+#ifdef VM
+    else if (!strcmp(name, "-zswap"))
+      zswap_page_cnt = atoi(value);
+    else if (!strcmp(name, "-fault-around"))
+      exception_set_fault_around(atoi(value));
+    else if (!strcmp(name, "-rss"))
+      frame_set_rss_limit(atoi(value));
+    else if (!strcmp(name, "-vm-policy")) {
+      if (value == NULL || !frame_set_policy(value))
+        PANIC("unknown replacement policy `%s'", value ? value : "");
+    }
 #endif
     else
       PANIC("unknown option `%s' (use -h for help)", name);
@@ -282,6 +364,15 @@ static void run_task(char **argv) {
   printf("Execution of '%s' complete.\n", task);
 }
 
+/* Prints kernel memory usage. */
+static void print_memstat(char **argv UNUSED) {
+  palloc_print_stats();
+  malloc_print_stats();
+#ifdef VM
+  SD_print_stats();
+#endif
+}
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void run_actions(char **argv) {
@@ -295,6 +386,7 @@ static void run_actions(char **argv) {
   /* Table of supported actions. */
   static const struct action actions[] = {
       {"run", 2, run_task},
+      {"memstat", 1, print_memstat},
 #ifdef FILESYS
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
@@ -340,6 +432,7 @@ static void usage(void) {
 #else
       "  run TEST           Run TEST.\n"
 #endif
+      "  memstat            Print kernel memory usage.\n"
 #ifdef FILESYS
       "  ls                 List files in the root directory.\n"
       "  cat FILE           Print FILE to the console.\n"
@@ -357,13 +450,24 @@ static void usage(void) {
       "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
       "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
 #ifdef VM
-      "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+      "  -swap=BDEV[:PRIO][,...]\n"
+      "                     Use the BDEVs for swap instead of default, higher\n"
+      "                     PRIO first (default 0), striping across equals.\n"
 #endif
 #endif
       "  -rs=SEED           Set random number seed to SEED.\n"
       "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
       "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+      "  -zswap=PAGES       Cache swapped pages compressed in PAGES pages.\n"
+      "  -vm-policy=NAME    Use page replacement policy NAME:\n"
+      "                     clock (default), wsclock or aging.\n"
+      "  -fault-around=N    Map up to N pages after a fault on a file page\n"
+      "                     (default 8, 0 to disable).\n"
+      "  -rss=PAGES         Limit each process to PAGES resident frames\n"
+      "                     (default 0, no limit).\n"
 #endif
   );
   shutdown_power_off();
@@ -375,7 +479,7 @@ static void locate_block_devices(void) {
   locate_block_device(BLOCK_FILESYS, filesys_bdev_name);
   locate_block_device(BLOCK_SCRATCH, scratch_bdev_name);
 #ifdef VM
-  locate_block_device(BLOCK_SWAP, swap_bdev_name);
+  locate_swap_devices();
 #endif
 }
 
@@ -399,4 +503,43 @@ static void locate_block_device(enum block_type role, const char *name) {
     block_set_role(role, block);
   }
 }
+
+#ifdef VM
+/* Adds the swap devices: the ones -swap lists, or else every block
+   device of type swap, all with priority 0 so that swap is striped
+   across them. */
+static void locate_swap_devices(void) {
+  struct block *block;
+
+  if (swap_bdev_names != NULL) {
+    char *name, *save_ptr;
+
+    for (name = strtok_r(swap_bdev_names, ",", &save_ptr); name != NULL;
+         name = strtok_r(NULL, ",", &save_ptr)) {
+      char *prio = strchr(name, ':');
+
+      if (prio != NULL) *prio++ = '\0';
+      block = block_get_by_name(name);
+      if (block == NULL) PANIC("No such block device \"%s\"", name);
+      add_swap_device(block, prio != NULL ? atoi(prio) : 0);
+    }
+  } else {
+    for (block = block_first(); block != NULL; block = block_next(block))
+      if (block_type(block) == BLOCK_SWAP) add_swap_device(block, 0);
+  }
+}
+
+/* Adds BLOCK as a swap device of priority PRIO.  The first one also
+   takes the swap role. */
+static void add_swap_device(struct block *block, int prio) {
+  if (!SD_add_device(block, prio)) {
+    printf("%s: not using %s: too many devices or a duplicate\n",
+           block_type_name(BLOCK_SWAP), block_name(block));
+    return;
+  }
+  printf("%s: using %s (priority %d)\n", block_type_name(BLOCK_SWAP),
+         block_name(block), prio);
+  if (block_get_role(BLOCK_SWAP) == NULL) block_set_role(BLOCK_SWAP, block);
+}
+#endif
 #endif
@@ -11,6 +11,10 @@
 #include "threads/io.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "userprog/gdt.h"
+#include "userprog/syscall.h"
+#endif
 
 /* Programmable Interrupt Controller (PIC) registers.
    A PC has two PICs, called the master and slave PICs, with the
@@ -344,6 +348,16 @@ void intr_handler(struct intr_frame *frame) {
 
     if (yield_on_return) thread_yield();
   }
+
+#ifdef VM
+  /* A process chosen by the OOM killer (see vm/frame.c) dies instead
+     of returning to user mode, even if it never faults or makes a
+     system call again. */
+  if (frame->cs == SEL_UCSEG && thread_current()->oom_killed) {
+    intr_enable();
+    exit(-1);
+  }
+#endif
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -41,6 +42,8 @@ struct desc
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
     struct lock lock;           /* Lock. */
+    size_t used_cnt;            /* Blocks handed out. */
+    size_t arena_cnt;           /* Arenas owned. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -64,6 +67,10 @@ struct block
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Big blocks, updated with interrupts off. */
+static size_t big_block_cnt;    /* Big blocks handed out. */
+static size_t big_page_cnt;     /* Pages in those blocks. */
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
 
@@ -107,10 +114,17 @@ malloc (size_t size)
       /* SIZE is too big for any descriptor.
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
-      a = palloc_get_multiple (0, page_cnt);
+      enum intr_level old_level;
+
+      a = palloc_get_multiple (PAL_MALLOC, page_cnt);
       if (a == NULL)
         return NULL;
 
+      old_level = intr_disable ();
+      big_block_cnt++;
+      big_page_cnt += page_cnt;
+      intr_set_level (old_level);
+
       /* Initialize the arena to indicate a big block of PAGE_CNT
          pages, and return it. */
       a->magic = ARENA_MAGIC;
@@ -127,12 +141,13 @@ malloc (size_t size)
       size_t i;
 
       /* Allocate a page. */
-      a = palloc_get_page (0);
+      a = palloc_get_page (PAL_MALLOC);
       if (a == NULL) 
         {
           lock_release (&d->lock);
           return NULL; 
         }
+      d->arena_cnt++;
 
       /* Initialize arena and add its blocks to the free list. */
       a->magic = ARENA_MAGIC;
@@ -149,6 +164,7 @@ malloc (size_t size)
   b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
   a = block_to_arena (b);
   a->free_cnt--;
+  d->used_cnt++;
   lock_release (&d->lock);
   return b;
 }
@@ -237,6 +253,7 @@ free (void *p)
 
           /* Add block to free list. */
           list_push_front (&d->free_list, &b->free_elem);
+          d->used_cnt--;
 
           /* If the arena is now entirely unused, free it. */
           if (++a->free_cnt >= d->blocks_per_arena) 
@@ -250,6 +267,7 @@ free (void *p)
                   list_remove (&b->free_elem);
                 }
               palloc_free_page (a);
+              d->arena_cnt--;
             }
 
           lock_release (&d->lock);
@@ -257,12 +275,69 @@ free (void *p)
       else
         {
           /* It's a big block.  Free its pages. */
+          enum intr_level old_level = intr_disable ();
+          big_block_cnt--;
+          big_page_cnt -= a->free_cnt;
+          intr_set_level (old_level);
+
           palloc_free_multiple (a, a->free_cnt);
           return;
         }
     }
 }
 
+/* Stores the usage of each descriptor, and of big blocks, into
+   *STATS. */
+void
+malloc_get_stats (struct memstat *stats)
+{
+  enum intr_level old_level;
+  size_t i;
+
+  for (i = 0; i < MEMSTAT_DESC_CNT; i++)
+    {
+      struct memstat_desc *sd = &stats->descs[i];
+
+      if (i < desc_cnt)
+        {
+          struct desc *d = &descs[i];
+
+          lock_acquire (&d->lock);
+          sd->block_size = d->block_size;
+          sd->used_cnt = d->used_cnt;
+          sd->arena_cnt = d->arena_cnt;
+          lock_release (&d->lock);
+        }
+      else
+        sd->block_size = sd->used_cnt = sd->arena_cnt = 0;
+    }
+
+  old_level = intr_disable ();
+  stats->big_block_cnt = big_block_cnt;
+  stats->big_page_cnt = big_page_cnt;
+  intr_set_level (old_level);
+}
+
+/* Prints the usage of each descriptor. */
+void
+malloc_print_stats (void)
+{
+  struct memstat stats;
+  size_t i;
+
+  malloc_get_stats (&stats);
+  for (i = 0; i < MEMSTAT_DESC_CNT; i++)
+    {
+      const struct memstat_desc *sd = &stats.descs[i];
+      if (sd->block_size != 0)
+        printf ("malloc: %4zu-byte blocks: %zu used (%zu bytes), "
+                "%zu arenas\n", sd->block_size, sd->used_cnt,
+                sd->used_cnt * sd->block_size, sd->arena_cnt);
+    }
+  printf ("malloc: big blocks: %zu using %zu pages\n",
+          stats.big_block_cnt, stats.big_page_cnt);
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
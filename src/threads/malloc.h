@@ -2,6 +2,7 @@
 #define THREADS_MALLOC_H
 
 #include <debug.h>
+#include <memstat.h>
 #include <stddef.h>
 
 void malloc_init (void);
@@ -9,5 +10,7 @@ void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
+void malloc_get_stats (struct memstat *);
+void malloc_print_stats (void);
 
 #endif /* threads/malloc.h */
@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -31,6 +32,14 @@ struct pool
     struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+
+    /* Accounting.  Pages are freed with interrupts off from the
+       scheduler, so these are updated with interrupts disabled
+       rather than under LOCK. */
+    uint8_t *tags;                      /* enum memstat_tag per page. */
+    size_t used_cnt;                    /* Pages in use. */
+    size_t peak_cnt;                    /* Maximum of USED_CNT. */
+    size_t tag_cnt[MEMSTAT_TAG_CNT];    /* Pages in use per tag. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -39,6 +48,8 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static void get_pool_stats (struct pool *, struct memstat_pool *);
+static void print_pool_stats (const char *name, const struct memstat_pool *);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -82,7 +93,21 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   lock_release (&pool->lock);
 
   if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
+    {
+      unsigned tag = (flags & PAL_TAG_MASK) >> PAL_TAG_SHIFT;
+      enum intr_level old_level;
+
+      ASSERT (tag < MEMSTAT_TAG_CNT);
+      memset (pool->tags + page_idx, tag, page_cnt);
+      old_level = intr_disable ();
+      pool->used_cnt += page_cnt;
+      if (pool->used_cnt > pool->peak_cnt)
+        pool->peak_cnt = pool->used_cnt;
+      pool->tag_cnt[tag] += page_cnt;
+      intr_set_level (old_level);
+
+      pages = pool->base + PGSIZE * page_idx;
+    }
   else
     pages = NULL;
 
@@ -119,6 +144,8 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 {
   struct pool *pool;
   size_t page_idx;
+  enum intr_level old_level;
+  size_t i;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
@@ -138,9 +165,51 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 #endif
 
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+
+  old_level = intr_disable ();
+  pool->used_cnt -= page_cnt;
+  for (i = page_idx; i < page_idx + page_cnt; i++)
+    pool->tag_cnt[pool->tags[i]]--;
+  intr_set_level (old_level);
+
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
 }
 
+/* Returns the base of the user pool and stores the number of
+   pages in it into *PAGE_CNT. */
+void *
+palloc_user_pool (size_t *page_cnt)
+{
+  *page_cnt = bitmap_size (user_pool.used_map);
+  return user_pool.base;
+}
+
+/* Returns the number of free pages in the user pool. */
+size_t
+palloc_user_free_cnt (void)
+{
+  return bitmap_size (user_pool.used_map) - user_pool.used_cnt;
+}
+
+/* Stores the usage of both pools into *STATS. */
+void
+palloc_get_stats (struct memstat *stats)
+{
+  get_pool_stats (&kernel_pool, &stats->kernel_pool);
+  get_pool_stats (&user_pool, &stats->user_pool);
+}
+
+/* Prints the usage of both pools. */
+void
+palloc_print_stats (void)
+{
+  struct memstat stats;
+
+  palloc_get_stats (&stats);
+  print_pool_stats ("kernel pool", &stats.kernel_pool);
+  print_pool_stats ("user pool", &stats.user_pool);
+}
+
 /* Frees the page at PAGE. */
 void
 palloc_free_page (void *page) 
@@ -153,10 +222,11 @@ palloc_free_page (void *page)
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  /* We'll put the pool's used_map at its base, followed by its
+     per-page tags.  Calculate the space needed for both and
+     subtract it from the pool's size. */
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size + page_cnt, PGSIZE);
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -165,8 +235,11 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
 
   /* Initialize the pool. */
   lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->tags = (uint8_t *) base + bm_size;
   p->base = base + bm_pages * PGSIZE;
+  p->used_cnt = p->peak_cnt = 0;
+  memset (p->tag_cnt, 0, sizeof p->tag_cnt);
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -180,3 +253,51 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Stores the usage of POOL into *STATS. */
+static void
+get_pool_stats (struct pool *pool, struct memstat_pool *stats)
+{
+  size_t page_cnt = bitmap_size (pool->used_map);
+  size_t run = 0;
+  enum intr_level old_level;
+  size_t i;
+
+  stats->page_cnt = page_cnt;
+  stats->largest_free_run = 0;
+
+  lock_acquire (&pool->lock);
+  for (i = 0; i < page_cnt; i++)
+    if (!bitmap_test (pool->used_map, i))
+      {
+        if (++run > stats->largest_free_run)
+          stats->largest_free_run = run;
+      }
+    else
+      run = 0;
+  lock_release (&pool->lock);
+
+  old_level = intr_disable ();
+  stats->used_cnt = pool->used_cnt;
+  stats->peak_cnt = pool->peak_cnt;
+  memcpy (stats->tag_cnt, pool->tag_cnt, sizeof stats->tag_cnt);
+  intr_set_level (old_level);
+}
+
+/* Prints STATS, the usage of the pool called NAME. */
+static void
+print_pool_stats (const char *name, const struct memstat_pool *stats)
+{
+  static const char *tag_names[MEMSTAT_TAG_CNT] =
+    {"other", "threads", "userprog", "filesys", "vm", "malloc"};
+  size_t i;
+
+  printf ("%s: %zu of %zu pages used (peak %zu), "
+          "largest free run %zu pages\n",
+          name, stats->used_cnt, stats->page_cnt, stats->peak_cnt,
+          stats->largest_free_run);
+  printf ("%s:", name);
+  for (i = 0; i < MEMSTAT_TAG_CNT; i++)
+    printf (" %s %zu", tag_names[i], stats->tag_cnt[i]);
+  printf ("\n");
+}
@@ -2,13 +2,26 @@
 #define THREADS_PALLOC_H
 
 #include <stddef.h>
+#include <memstat.h>
+
+/* Position of the accounting tag within enum palloc_flags. */
+#define PAL_TAG_SHIFT 3
+#define PAL_TAG_MASK (07 << PAL_TAG_SHIFT)
 
 /* How to allocate pages. */
 enum palloc_flags
   {
     PAL_ASSERT = 001,           /* Panic on failure. */
     PAL_ZERO = 002,             /* Zero page contents. */
-    PAL_USER = 004              /* User page. */
+    PAL_USER = 004,             /* User page. */
+
+    /* Subsystem to account the pages to.  At most one may be
+       given; pages without one are counted as MEMSTAT_OTHER. */
+    PAL_THREADS = MEMSTAT_THREADS << PAL_TAG_SHIFT,
+    PAL_USERPROG = MEMSTAT_USERPROG << PAL_TAG_SHIFT,
+    PAL_FILESYS = MEMSTAT_FILESYS << PAL_TAG_SHIFT,
+    PAL_VM = MEMSTAT_VM << PAL_TAG_SHIFT,
+    PAL_MALLOC = MEMSTAT_MALLOC << PAL_TAG_SHIFT
   };
 
 void palloc_init (size_t user_page_limit);
@@ -16,5 +29,9 @@ void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void *palloc_user_pool (size_t *page_cnt);
+size_t palloc_user_free_cnt (void);
+void palloc_get_stats (struct memstat *);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
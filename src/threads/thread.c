@@ -187,7 +187,7 @@ tid_t thread_create(const char* name, int priority, thread_func* function,
   ASSERT(function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page(PAL_ZERO);
+  t = palloc_get_page(PAL_ZERO | PAL_THREADS);
   if (t == NULL) return TID_ERROR;
 
   /* Initialize thread. */
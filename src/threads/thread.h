@@ -2,7 +2,7 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
-#include <hash.h>
+#include <ohash.h>
 #include <list.h>
 #include <stdint.h>
 
@@ -106,7 +106,7 @@ struct thread {
 
   struct file* fd_table[FD_TABLE_SIZE]; /* Per-process file descriptor table */
 
-  struct thread* parent;      /* Parent process */
+  struct thread* parent;      /* Parent process (NULL once detached) */
   struct list children;       /* List of child processes */
   struct list_elem childelem; /* List element for child processes list */
 
@@ -119,11 +119,21 @@ struct thread {
   int exit_status;         /* Return value of calling exit */
   struct file* executable; /* Current running file */
 
-  struct hash SPT; /* PER-PROCESS SPT */
+  struct ohash SPT; /* PER-PROCESS SPT */
+  struct vm_area* areas; /* Root of the VM area tree (see vm/area.h) */
   void* esp;       /* stack pointer of this process.*/
 
   struct list mmap_table;   /* List of mappings (mmap table) */
   void* data_segment_start; /* Pointer to the starting point of data segment */
+  void* heap_start;         /* Start of the sbrk() heap: end of the image */
+  void* brk;                /* Current program break */
+  struct faultstat_class* fault_stats; /* Page faults by class, or NULL */
+  size_t rss;              /* Frames mapped (resident set size) */
+  size_t swap_cnt;         /* Pages in swap */
+  size_t rss_limit;        /* Resident set limit in frames; 0: default */
+  bool oom_killed;         /* Chosen by the OOM killer: exit before user mode */
+  struct thread* waiting_for; /* Child it is blocked on in process_wait() */
+  bool wait_interrupted;      /* Woken from that by the OOM killer */
 #endif
 
   /* Owned by thread.c. */
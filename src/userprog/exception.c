@@ -2,6 +2,7 @@
 
 #include <debug.h>
 #include <inttypes.h>
+#include <mman.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,20 +11,31 @@
 #include "filesys/filesys.h"
 #include "filesys/off_t.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
+#include "userprog/uaccess.h"
 #include "vm/frame.h"
+#include "vm/mmap.h"
 #include "vm/page.h"
 #include "vm/swap.h"  // will be needed for stack swap!
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
 
+/* Fault-around: number of pages to map after a file-backed fault. */
+static size_t fault_around_pages = FAULT_AROUND_DEFAULT;
+
+/* Page faults by class, since boot. */
+static struct faultstat_class fault_stats[FAULT_CLASS_CNT];
+
 static void kill(struct intr_frame*);
 static void page_fault(struct intr_frame*);
+static enum fault_class handle_fault(struct intr_frame*, void* fault_addr);
 
 /* Registers handlers for interrupts that can be caused by user
    programs.
@@ -69,9 +81,77 @@ void exception_init(void) {
   intr_register_int(14, 0, INTR_OFF, page_fault, "#PF Page-Fault Exception");
 }
 
+/* Sets the number of pages fault-around maps; 0 turns it off. */
+void exception_set_fault_around(size_t pages) { fault_around_pages = pages; }
+
+/* Returns the CPU's time-stamp counter, in cycles. */
+static inline uint64_t rdtsc(void) {
+  uint64_t tsc;
+  asm volatile("rdtsc" : "=A"(tsc));
+  return tsc;
+}
+
+/* Adds a fault of class CLS that took CYCLES to handle to the
+   statistics in STATS. */
+static void class_add(struct faultstat_class* stats, enum fault_class cls,
+                      uint64_t cycles) {
+  struct faultstat_class* c = &stats[cls];
+  int bucket = 0;
+
+  while (bucket < FAULTSTAT_BUCKET_CNT - 1 && cycles >> (bucket + 1) != 0)
+    bucket++;
+  c->cnt++;
+  c->cycles += cycles;
+  c->hist[bucket]++;
+}
+
+/* Accounts a fault of class CLS that took CYCLES to handle, both
+   globally and to the current process. */
+static void fault_account(enum fault_class cls, uint64_t cycles) {
+  struct thread* cur = thread_current();
+  enum intr_level old_level;
+
+  // Allocated on the first fault; freed by process_exit().
+  if (cur->fault_stats == NULL)
+    cur->fault_stats = calloc(FAULT_CLASS_CNT, sizeof *cur->fault_stats);
+
+  old_level = intr_disable();
+  class_add(fault_stats, cls, cycles);
+  if (cur->fault_stats != NULL) class_add(cur->fault_stats, cls, cycles);
+  intr_set_level(old_level);
+}
+
+/* Copies the page fault statistics of the current process and of
+   the whole system into STATS. */
+void exception_get_stats(struct faultstat* stats) {
+  struct thread* cur = thread_current();
+  enum intr_level old_level = intr_disable();
+
+  if (cur->fault_stats != NULL)
+    memcpy(stats->self, cur->fault_stats, sizeof stats->self);
+  else
+    memset(stats->self, 0, sizeof stats->self);
+  memcpy(stats->all, fault_stats, sizeof stats->all);
+  intr_set_level(old_level);
+}
+
 /* Prints exception statistics. */
 void exception_print_stats(void) {
+  static const char* names[FAULT_CLASS_CNT] = {"stack", "file", "mmap",
+                                               "swap",  "cow",  "invalid"};
+  int i, b;
+
   printf("Exception: %lld page faults\n", page_fault_cnt);
+  for (i = 0; i < FAULT_CLASS_CNT; i++) {
+    const struct faultstat_class* c = &fault_stats[i];
+
+    if (c->cnt == 0) continue;
+    printf("Exception: %zu %s faults, avg %" PRIu64 " cycles, log2 hist:",
+           c->cnt, names[i], c->cycles / c->cnt);
+    for (b = 0; b < FAULTSTAT_BUCKET_CNT; b++)
+      if (c->hist[b] != 0) printf(" %d:%zu", b, c->hist[b]);
+    printf("\n");
+  }
 }
 
 /* Handler for an exception (probably) caused by a user process. */
@@ -112,6 +192,114 @@ static void kill(struct intr_frame* f) {
   }
 }
 
+/* Loads Q, a FOR_FILE or FOR_MMAP page that is not loaded yet, ahead
+   of any access to it: from the page cache if it is read-only and
+   cached there, otherwise from its file.  Returns true if Q is now
+   mapped. */
+bool exception_prefetch(struct page* q) {
+  uint32_t* pd = q->owner->pagedir;
+  uint8_t* kpage = NULL;
+
+  ASSERT(q->purpose == FOR_FILE || q->purpose == FOR_MMAP);
+  if (q->read_bytes == 0 || q->is_swapped ||
+      pagedir_get_page(pd, q->page_addr) != NULL)
+    return false;
+
+  if (!q->is_writable) kpage = frame_get_shared(q);
+  if (kpage) {
+    q->frame_addr = kpage;
+    if (!pagedir_set_page(pd, q->page_addr, kpage, q->is_writable)) {
+      frame_release(q);
+      q->frame_addr = NULL;
+      return false;
+    }
+    frame_mark_prefaulted(q);
+    return true;
+  }
+
+  // A new frame has no mapping, so it cannot be evicted while it is
+  // filled: frame_map() goes last, once the PTE is in place.
+  kpage = frame_alloc(PAL_USER, true);
+  if (file_read_at(q->page_file, kpage, q->read_bytes, q->ofs) !=
+      (off_t)q->read_bytes) {
+    frame_free(kpage);
+    return false;
+  }
+  memset(kpage + q->read_bytes, 0, PGSIZE - q->read_bytes);
+  if (!pagedir_set_page(pd, q->page_addr, kpage, q->is_writable)) {
+    frame_free(kpage);
+    return false;
+  }
+  q->frame_addr = kpage;
+  frame_map(kpage, q);
+  if (!q->is_writable) frame_share(kpage, q);
+  frame_mark_prefaulted(q);
+  return true;
+}
+
+/* Fault-around: after a fault on P, a FOR_FILE or FOR_MMAP page,
+   maps up to CNT of the pages that follow it, as long as they are
+   the next bytes of the same file and not loaded yet.  A
+   sequential sweep then takes one fault per run of pages instead
+   of one per page.  Only free frames are used: this never evicts.
+   Returns the number of pages mapped. */
+static size_t fault_around(struct page* p, size_t cnt) {
+  struct thread* cur = thread_current();
+  struct page* prev = p;
+  size_t i;
+
+  for (i = 0; i < cnt; i++) {
+    uint8_t* upage = (uint8_t*)prev->page_addr + PGSIZE;
+    struct page* q;
+
+    if (!is_user_vaddr(upage) || frame_pool_low()) break;
+    q = SPT_get(cur, upage);
+    if (!q || q->purpose != p->purpose || q->page_file != p->page_file ||
+        prev->read_bytes != PGSIZE || q->ofs != prev->ofs + PGSIZE ||
+        !exception_prefetch(q))
+      break;
+    prev = q;
+  }
+  return i;
+}
+
+/* Readahead for mmap: the window of pages mapped ahead of a fault
+   on P doubles, up to MMAP_RA_MAX, while faults on its mapping
+   land right after the pages mapped ahead last time, and drops
+   back to MMAP_RA_MIN when one does not.  madvise() can pin the
+   window at MMAP_RA_MAX (sequential) or 0 (random); sequential
+   access also drops the pages MMAP_RA_MAX pages behind the
+   fault, which will not be used again. */
+static void mmap_readahead(struct page* p) {
+  struct thread* cur = thread_current();
+  struct mapping* m = find_mapping_addr(cur, p->page_addr);
+  size_t cnt, i;
+
+  if (!m) return;
+  if (m->advice == MADV_SEQUENTIAL)
+    m->ra_window = MMAP_RA_MAX;
+  else if (m->advice == MADV_RANDOM)
+    m->ra_window = 0;
+  else if (p->page_addr == m->ra_next && m->ra_window > 0)
+    m->ra_window = m->ra_window * 2 < MMAP_RA_MAX ? m->ra_window * 2
+                                                  : MMAP_RA_MAX;
+  else
+    m->ra_window = MMAP_RA_MIN;
+
+  cnt = fault_around(p, m->ra_window);
+  m->ra_next = (uint8_t*)p->page_addr + (cnt + 1) * PGSIZE;
+
+  if (m->advice != MADV_SEQUENTIAL) return;
+  for (i = 1; i <= cnt + 1; i++) {
+    uint8_t* behind = (uint8_t*)p->page_addr - (MMAP_RA_MAX + i) * PGSIZE;
+    struct page* q;
+
+    if (behind < (uint8_t*)m->addr || behind > (uint8_t*)p->page_addr) break;
+    q = SPT_search(cur, behind);
+    if (q && q->purpose == FOR_MMAP) frame_drop(q);
+  }
+}
+
 /* Page fault handler.  This is a skeleton that must be filled in
    to implement virtual memory.  Some solutions to project 2 may
    also require modifying this code.
@@ -124,10 +312,9 @@ static void kill(struct intr_frame* f) {
    description of "Interrupt 14--Page Fault Exception (#PF)" in
    [IA32-v3a] section 5.15 "Exception and Interrupt Reference". */
 static void page_fault(struct intr_frame* f) {
-  bool not_present; /* True: not-present page, false: writing r/o page. */
-  bool write;       /* True: access was write, false: access was read. */
-  bool user;        /* True: access by user, false: access by kernel. */
   void* fault_addr; /* Fault address. */
+  uint64_t start;
+  enum fault_class cls;
 
   /* Obtain faulting address, the virtual address that was
      accessed to cause the fault.  It may point to code or to
@@ -145,6 +332,30 @@ static void page_fault(struct intr_frame* f) {
   /* Count page faults. */
   page_fault_cnt++;
 
+  /* Chosen by the OOM killer (see vm/frame.c): die now, if the fault
+     came from user mode. A kernel-mode fault may hold locks that exit()
+     would need; intr_handler() kills the process on its way back to
+     user mode instead. */
+  if ((f->error_code & PF_U) && thread_current()->oom_killed) exit(-1);
+
+  start = rdtsc();
+  cls = handle_fault(f, fault_addr);
+  fault_account(cls, rdtsc() - start);
+  if (cls == FAULT_INVALID) {
+    /* A bad address handed to a system call: the copy fails instead. */
+    if ((f->error_code & PF_U) == 0 && uaccess_fixup(f)) return;
+    exit(-1);
+  }
+}
+
+/* Brings in the page that FAULT_ADDR refers to, and returns what
+   kind of fault it was.  Returns FAULT_INVALID, with nothing
+   mapped, if the access was bad. */
+static enum fault_class handle_fault(struct intr_frame* f, void* fault_addr) {
+  bool not_present; /* True: not-present page, false: writing r/o page. */
+  bool write;       /* True: access was write, false: access was read. */
+  bool user;        /* True: access by user, false: access by kernel. */
+
   /* Determine cause. */
   not_present = (f->error_code & PF_P) == 0;
   write = (f->error_code & PF_W) != 0;
@@ -173,7 +384,7 @@ static void page_fault(struct intr_frame* f) {
 
   // Case 0. Bad access -> just raise error.
   if (fault_addr == NULL || !is_user_vaddr(fault_addr)) {
-    exit(-1);
+    return FAULT_INVALID;
   }
 
   // printf("Fault at %p, eip = %p, esp = %p\n", fault_addr, f->eip, f->esp);
@@ -182,27 +393,33 @@ static void page_fault(struct intr_frame* f) {
 
   void* fault_page_addr = pg_round_down(fault_addr);
   // printf("Search for %p\n", fault_page_addr);
-  struct page* fault_page = SPT_search(thread_current(), fault_page_addr);
+  struct page* fault_page = SPT_get(thread_current(), fault_page_addr);
 
   // Case 1. SPT does not exist
   //  -> page fault is caused by stack growth attempt.
   if (!fault_page) {
     // 8MB stack size limit.
-    if (fault_addr <= PHYS_BASE - 0x800000) exit(-1);
+    if (fault_addr <= PHYS_BASE - 0x800000) return FAULT_INVALID;
 
     if (fault_addr >= esp - 32) {
+      // Reading fresh stack sees zeros: share the zero frame for now.
+      if (!write) {
+        struct page* p = SPT_insert(NULL, 0, fault_page_addr, NULL, 0, PGSIZE,
+                                    true, FOR_STACK);
+        frame_map_zero(p);
+        thread_current()->esp = fault_addr;
+        return FAULT_STACK;
+      }
+
       void* kpage = frame_alloc(PAL_USER | PAL_ZERO, false);
-      struct frame* f = find_frame(kpage);
-      f->is_evictable = true;
-      f->owner_thread = thread_current();
 
       pagedir_set_page(thread_current()->pagedir, fault_page_addr, kpage, true);
       SPT_insert(NULL, 0, fault_page_addr, kpage, 0, PGSIZE, true, FOR_STACK);
       thread_current()->esp = fault_addr;
-      return;
+      return FAULT_STACK;
     } else {
       // printf("STACK GROWTH ERROR\n");
-      exit(-1);
+      return FAULT_INVALID;
     }
   }
 
@@ -216,57 +433,86 @@ static void page_fault(struct intr_frame* f) {
     size_t page_zero_bytes = fault_page->zero_bytes;
     bool writable = fault_page->is_writable;
 
+    // Write to a page that fork() shared copy-on-write.
+    if (!not_present && write && fault_page->is_cow) {
+      frame_break_cow(fault_page);
+      return FAULT_COW;
+    }
+    // Otherwise the page gets a frame of its own below.
+    if (not_present) fault_page->is_cow = false;
+
     // If this fault is caused by write, but the page is not writable,
     // raise error!
     if (write && !writable) {
       // printf("WRITE PERM ERROR\n");
-      exit(-1);
+      return FAULT_INVALID;
+    }
+
+    // First write to a demand-zero page that was mapped to the zero frame.
+    if (!not_present && write && frame_is_zero(fault_page->frame_addr)) {
+      frame_break_zero(fault_page);
+      return FAULT_COW;
     }
+
     switch (fault_page->purpose) {
       case FOR_FILE:
         if (!fault_page->is_swapped) {
+          // Nothing to read (bss): a read sees zeros.
+          if (page_read_bytes == 0 && !write) {
+            frame_map_zero(fault_page);
+            return FAULT_FILE;
+          }
+
+          // Read-only pages (code, rodata) may already be in memory for
+          // another process running the same executable.
+          if (!writable) {
+            uint8_t* kpage = frame_get_shared(fault_page);
+            if (kpage) {
+              fault_page->frame_addr = kpage;
+              if (!pagedir_set_page(thread_current()->pagedir, upage, kpage,
+                                    false))
+                printf("Failed!: pagedir_set_page in thread: %s\n",
+                       thread_name());
+              fault_around(fault_page, fault_around_pages);
+              return FAULT_FILE;
+            }
+          }
+
           // Repeat load_segment
+          // (The new frame has no mapping, so it cannot be evicted while
+          // it is filled: frame_map() goes last, once the PTE is set.)
           file_seek(file, ofs);
           uint8_t* kpage = frame_alloc(PAL_USER, true);
 
-          struct frame* f = find_frame(kpage);
-          f->page_addr = upage;
-          f->is_evictable = true;
-          f->owner_thread = thread_current();
-
-          fault_page->frame_addr = kpage;
-          fault_page->is_swapped = false;
-
           off_t n = file_read(file, kpage, page_read_bytes);
           if (n != (int)page_read_bytes) {
             // printf("File read error\n");
             frame_free(kpage);
-            exit(-1);
+            return FAULT_INVALID;
           }
           memset(kpage + page_read_bytes, 0, page_zero_bytes);
 
+          fault_page->frame_addr = kpage;
+          fault_page->is_swapped = false;
+
           bool ok = pagedir_set_page(thread_current()->pagedir, upage, kpage,
                                      writable);
           if (!ok) {
             printf("Failed!: pagedir_set_page in thread: %s\n", thread_name());
           }
+          frame_map(kpage, fault_page);
+          if (!writable) frame_share(kpage, fault_page);
 
-          return;
+          fault_around(fault_page, fault_around_pages);
+          return FAULT_FILE;
 
         } else {
           // FIXME: Page is in the swap disk.
-          size_t swap_i = fault_page->swap_i;
 
           // Repeat load_segment
           file_seek(file, ofs);
           uint8_t* kpage = frame_alloc(PAL_USER, true);
           // if (!kpage) printf("Your frame_alloc is trash\n");
-          struct frame* f = find_frame(kpage);
-          f->page_addr = upage;
-          f->is_evictable = true;
-          f->owner_thread = thread_current();
-
-          fault_page->frame_addr = kpage;
 
           // Read from corresponding disk file.
           /*
@@ -277,54 +523,62 @@ static void page_fault(struct intr_frame* f) {
               fault_page->swap_i);
               */
 
-          SD_read(swap_i, kpage);
-          fault_page->is_swapped = false;
+          // Unmapped, the frame cannot be evicted during the read.
+          frame_swap_in(fault_page, kpage);
           // memset(kpage + page_read_bytes, 0, page_zero_bytes);
+          fault_page->frame_addr = kpage;
           bool ok = pagedir_set_page(thread_current()->pagedir, upage, kpage,
                                      writable);
           if (!ok) {
             printf("Failed!: pagedir_set_page in thread: %s\n", thread_name());
           }
-          return;
+          frame_map(kpage, fault_page);
+          return FAULT_SWAP;
         }
 
         break;
 
       case FOR_STACK:
+      case FOR_ANON:
         if (!fault_page->is_swapped) {
-          // This case should've covered by !fault_page check.
-          // I have no idea. Let's just pray.
+          // Not loaded yet: a forked child's copy of a stack page that
+          // the parent had only read (mapped to the zero frame), or an
+          // anonymous page touched for the first time.
+          if (!write) {
+            frame_map_zero(fault_page);
+            return FAULT_STACK;
+          }
 
           // Allocate frame.
-          uint8_t* kpage = frame_alloc(PAL_USER, false);
+          uint8_t* kpage = frame_alloc(PAL_USER | PAL_ZERO,
+                                       fault_page->purpose == FOR_ANON);
           fault_page->frame_addr = kpage;
 
           // Setup stack.
           pagedir_set_page(thread_current()->pagedir, upage, kpage, writable);
-          thread_current()->esp = fault_addr;
-          return;
+          frame_map(kpage, fault_page);
+          if (fault_page->purpose == FOR_STACK)
+            thread_current()->esp = fault_addr;
+          return FAULT_STACK;
 
         } else {
           // Page is in the swap disk.
-          size_t swap_i = fault_page->swap_i;
 
           // Allocate frame
-          uint8_t* kpage = frame_alloc(PAL_USER, false);
-          struct frame* f = find_frame(kpage);
-          f->page_addr = upage;
-          f->is_evictable = true;
-          f->owner_thread = thread_current();
+          uint8_t* kpage =
+              frame_alloc(PAL_USER, fault_page->purpose == FOR_ANON);
 
-          fault_page->frame_addr = kpage;
-          fault_page->is_swapped = false;
-
-          // Read from corresponding disk file.
+          // Read from corresponding disk file. (Unmapped, the frame
+          // cannot be evicted meanwhile: frame_map() goes last.)
           // printf("Stack reading swap disk\n");
-          SD_read(swap_i, kpage);
+          frame_swap_in(fault_page, kpage);
 
+          fault_page->frame_addr = kpage;
           pagedir_set_page(thread_current()->pagedir, upage, kpage, writable);
-          thread_current()->esp = fault_addr;
-          return;
+          frame_map(kpage, fault_page);
+          if (fault_page->purpose == FOR_STACK)
+            thread_current()->esp = fault_addr;
+          return FAULT_SWAP;
         }
         break;
 
@@ -332,47 +586,38 @@ static void page_fault(struct intr_frame* f) {
         /* TEMPORARILY COPIED FROM `FOR_FILE` */
         if (!fault_page->is_swapped) {
           // Repeat load_segment
+          // (Unmapped, the frame cannot be evicted while it is filled.)
           file_seek(file, ofs);
           uint8_t* kpage = frame_alloc(PAL_USER, true);
 
-          struct frame* f = find_frame(kpage);
-          f->page_addr = upage;
-          f->is_evictable = true;
-          f->owner_thread = thread_current();
-
-          fault_page->frame_addr = kpage;
-          fault_page->is_swapped = false;
-
           off_t n = file_read(file, kpage, page_read_bytes);
           if (n != (int)page_read_bytes) {
             // printf("File read error\n");
             frame_free(kpage);
-            exit(-1);
+            return FAULT_INVALID;
           }
           memset(kpage + page_read_bytes, 0, page_zero_bytes);
 
+          fault_page->frame_addr = kpage;
+          fault_page->is_swapped = false;
+
           bool ok = pagedir_set_page(thread_current()->pagedir, upage, kpage,
                                      writable);
           if (!ok) {
             printf("Failed!: pagedir_set_page in thread: %s\n", thread_name());
           }
+          frame_map(kpage, fault_page);
 
-          return;
+          mmap_readahead(fault_page);
+          return FAULT_MMAP;
 
         } else {
           // FIXME: Page is in the swap disk.
-          size_t swap_i = fault_page->swap_i;
 
           // Repeat load_segment
           file_seek(file, ofs);
           uint8_t* kpage = frame_alloc(PAL_USER, true);
           // if (!kpage) printf("Your frame_alloc is trash\n");
-          struct frame* f = find_frame(kpage);
-          f->page_addr = upage;
-          f->is_evictable = true;
-          f->owner_thread = thread_current();
-
-          fault_page->frame_addr = kpage;
 
           // Read from corresponding disk file.
           /*
@@ -383,25 +628,27 @@ static void page_fault(struct intr_frame* f) {
               fault_page->swap_i);
               */
 
-          SD_read(swap_i, kpage);
-          fault_page->is_swapped = false;
+          // Unmapped, the frame cannot be evicted during the read.
+          frame_swap_in(fault_page, kpage);
           // memset(kpage + page_read_bytes, 0, page_zero_bytes);
+          fault_page->frame_addr = kpage;
           bool ok = pagedir_set_page(thread_current()->pagedir, upage, kpage,
                                      writable);
           if (!ok) {
             printf("Failed!: pagedir_set_page in thread: %s\n", thread_name());
           }
-          return;
+          frame_map(kpage, fault_page);
+          return FAULT_SWAP;
         }
         break;
 
       default:
         printf("You reached the undefined purpose\n");
-        exit(-1);
+        return FAULT_INVALID;
     }
   }
 
   printf("You reached the unreachable.\n");
 
-  exit(-1);
+  return FAULT_INVALID;
 }
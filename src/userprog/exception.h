@@ -1,12 +1,25 @@
 #ifndef USERPROG_EXCEPTION_H
 #define USERPROG_EXCEPTION_H
 
+#include <faultstat.h>
+#include <stdbool.h>
+#include <stddef.h>
+
 /* Page fault error code bits that describe the cause of the exception.  */
 #define PF_P 0x1    /* 0: not-present page. 1: access rights violation. */
 #define PF_W 0x2    /* 0: read, 1: write. */
 #define PF_U 0x4    /* 0: kernel, 1: user process. */
 
+/* Pages fault-around maps after a fault on a file-backed page,
+   by default. */
+#define FAULT_AROUND_DEFAULT 8
+
+struct page;
+
 void exception_init (void);
+void exception_set_fault_around (size_t pages);
+bool exception_prefetch (struct page *);
+void exception_get_stats (struct faultstat *);
 void exception_print_stats (void);
 
 #endif /* userprog/exception.h */
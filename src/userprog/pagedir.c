@@ -9,21 +9,30 @@
 #include "threads/pte.h"
 
 static uint32_t *active_pd(void);
-static void invalidate_pagedir(uint32_t *);
+static void invalidate_page(uint32_t *, const void *);
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
    Returns the new page directory, or a null pointer if memory
    allocation fails. */
 uint32_t *pagedir_create(void) {
-  uint32_t *pd = palloc_get_page(0);
+  uint32_t *pd = palloc_get_page(PAL_USERPROG);
   if (pd != NULL) memcpy(pd, init_page_dir, PGSIZE);
   return pd;
 }
 
+static void destroy(uint32_t *pd, bool free_pages);
+
 /* Destroys page directory PD, freeing all the pages it
    references. */
-void pagedir_destroy(uint32_t *pd) {
+void pagedir_destroy(uint32_t *pd) { destroy(pd, true); }
+
+/* Destroys page directory PD and its page tables, but not the
+   pages they map, which the caller has already freed (see
+   frame_release_all()). */
+void pagedir_destroy_tables(uint32_t *pd) { destroy(pd, false); }
+
+static void destroy(uint32_t *pd, bool free_pages) {
   uint32_t *pde;
 
   if (pd == NULL) return;
@@ -34,8 +43,9 @@ void pagedir_destroy(uint32_t *pd) {
       uint32_t *pt = pde_get_pt(*pde);
       uint32_t *pte;
 
-      for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
-        if (*pte & PTE_P) palloc_free_page(pte_get_page(*pte));
+      if (free_pages)
+        for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
+          if (*pte & PTE_P) palloc_free_page(pte_get_page(*pte));
       palloc_free_page(pt);
     }
   palloc_free_page(pd);
@@ -60,7 +70,7 @@ static uint32_t *lookup_page(uint32_t *pd, const void *vaddr, bool create) {
   pde = pd + pd_no(vaddr);
   if (*pde == 0) {
     if (create) {
-      pt = palloc_get_page(PAL_ZERO);
+      pt = palloc_get_page(PAL_ZERO | PAL_USERPROG);
       if (pt == NULL) return NULL;
 
       *pde = pde_create(pt);
@@ -131,7 +141,7 @@ void pagedir_clear_page(uint32_t *pd, void *upage) {
   pte = lookup_page(pd, upage, false);
   if (pte != NULL && (*pte & PTE_P) != 0) {
     *pte &= ~PTE_P;
-    invalidate_pagedir(pd);
+    invalidate_page(pd, upage);
   }
 }
 
@@ -153,7 +163,22 @@ void pagedir_set_dirty(uint32_t *pd, const void *vpage, bool dirty) {
       *pte |= PTE_D;
     else {
       *pte &= ~(uint32_t)PTE_D;
-      invalidate_pagedir(pd);
+      invalidate_page(pd, vpage);
+    }
+  }
+}
+
+/* Sets the writable bit to WRITABLE in the PTE for virtual page
+   VPAGE in PD, if VPAGE is mapped.  Used to share a page
+   copy-on-write and to give it back its write access. */
+void pagedir_set_writable(uint32_t *pd, const void *vpage, bool writable) {
+  uint32_t *pte = lookup_page(pd, vpage, false);
+  if (pte != NULL && (*pte & PTE_P) != 0) {
+    if (writable)
+      *pte |= PTE_W;
+    else {
+      *pte &= ~(uint32_t)PTE_W;
+      invalidate_page(pd, vpage);
     }
   }
 }
@@ -176,15 +201,17 @@ void pagedir_set_accessed(uint32_t *pd, const void *vpage, bool accessed) {
       *pte |= PTE_A;
     else {
       *pte &= ~(uint32_t)PTE_A;
-      invalidate_pagedir(pd);
+      invalidate_page(pd, vpage);
     }
   }
 }
 
 /* Loads page directory PD into the CPU's page directory base
-   register. */
+   register, unless it is already loaded.  Global (kernel) TLB
+   entries survive the load. */
 void pagedir_activate(uint32_t *pd) {
   if (pd == NULL) pd = init_page_dir;
+  if (pd == active_pd()) return;
 
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
@@ -205,18 +232,18 @@ static uint32_t *active_pd(void) {
   return ptov(pd);
 }
 
-/* Seom page table changes can cause the CPU's translation
+/* Some page table changes can cause the CPU's translation
    lookaside buffer (TLB) to become out-of-sync with the page
-   table.  When this happens, we have to "invalidate" the TLB by
-   re-activating it.
-
-   This function invalidates the TLB if PD is the active page
-   directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
-static void invalidate_pagedir(uint32_t *pd) {
-  if (active_pd() == pd) {
-    /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
-       "Translation Lookaside Buffers (TLBs)". */
-    pagedir_activate(pd);
-  }
+   table.  When this happens, we have to "invalidate" the TLB
+   entry for the page that changed.
+
+   A user page's entry can only be in the TLB if PD is the active
+   page directory.  Kernel page tables are shared by every page
+   directory and their entries are global, so a kernel page's
+   entry is flushed whichever PD is active.  invlpg drops just the
+   one entry.  See [IA32-v3a] 3.12 "Translation Lookaside Buffers
+   (TLBs)". */
+static void invalidate_page(uint32_t *pd, const void *vpage) {
+  if (is_kernel_vaddr(vpage) || active_pd() == pd)
+    asm volatile("invlpg (%0)" : : "r"(vpage) : "memory");
 }
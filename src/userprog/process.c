@@ -22,11 +22,13 @@
 #include "userprog/pagedir.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
+#include "vm/area.h"
 #include "vm/frame.h"
 #include "vm/mmap.h"
 #include "vm/page.h"
 
 static thread_func start_process NO_RETURN;
+static thread_func start_fork NO_RETURN;
 static bool load(const char* cmdline, void (**eip)(void), void** esp);
 
 /* Starts a new thread running a user program loaded from
@@ -39,7 +41,7 @@ tid_t process_execute(const char* file_name) {
 
   /* Make a copy of FILE_NAME.
      Otherwise there's a race between the caller and load(). */
-  fn_copy = palloc_get_page(0);
+  fn_copy = palloc_get_page(PAL_USERPROG);
   if (fn_copy == NULL) return TID_ERROR;
   strlcpy(fn_copy, file_name, PGSIZE);
 
@@ -191,6 +193,159 @@ static void start_process(void* file_name_) {
   NOT_REACHED();
 }
 
+/* What a forked child needs from its parent. */
+struct fork_info {
+  struct thread* parent;   /* Process being forked. */
+  struct intr_frame if_;   /* Its user context at the fork() call. */
+  struct semaphore done;   /* Upped once the child is set up... */
+  bool success;            /* ...and whether that worked. */
+};
+
+/* Creates a child process that is a copy of the running one and
+   resumes from user context IF_, with fork() returning 0.
+   Returns the child's thread id, or TID_ERROR if it could not be
+   created.  Memory is not copied: frames are shared copy-on-write
+   (see frame_fork_page()), so this costs page table updates
+   rather than file I/O. */
+tid_t process_fork(struct intr_frame* if_) {
+  struct fork_info info;
+  tid_t tid;
+
+  info.parent = thread_current();
+  info.if_ = *if_;
+  sema_init(&info.done, 0);
+  info.success = false;
+
+  tid = thread_create(thread_name(), PRI_DEFAULT, start_fork, &info);
+  if (tid == TID_ERROR) return TID_ERROR;
+
+  // The parent must not run (or fault) while its pages are copied.
+  sema_down(&info.done);
+  return info.success ? tid : TID_ERROR;
+}
+
+/* Adds a copy of the parent's page P, backed by CHILD_FILE, to
+   the running process's SPT, and to MMAP_PAGES if that is not
+   null.  Returns false if out of memory. */
+static bool fork_page(struct page* p, struct file* child_file,
+                      struct list* mmap_pages) {
+  struct page* c =
+      SPT_insert(child_file, p->ofs, p->page_addr, NULL, p->read_bytes,
+                 p->zero_bytes, p->is_writable, p->purpose);
+  if (c == NULL) return false;
+  if (mmap_pages) list_push_back(mmap_pages, &c->MMAP_elem);
+  return frame_fork_page(p, c);
+}
+
+/* Copies the parent's files, mappings and SPT into the running
+   (child) process.  Returns true if successful. */
+static bool fork_process(struct thread* parent) {
+  struct thread* cur = thread_current();
+  struct ohash_iterator it;
+  struct list_elem* e;
+  struct vm_area *pa, *a;
+  int i;
+
+  SPT_init();
+  cur->pagedir = pagedir_create();
+  if (cur->pagedir == NULL) return false;
+  process_activate();
+
+  // Files: the same files, at the same positions.
+  lock_acquire(&filesys_lock);
+  for (i = 2; i < FD_TABLE_SIZE; i++) {
+    if (parent->fd_table[i] == NULL) continue;
+    cur->fd_table[i] = file_reopen(parent->fd_table[i]);
+    if (cur->fd_table[i] == NULL) break;
+    file_seek(cur->fd_table[i], file_tell(parent->fd_table[i]));
+  }
+  if (parent->executable != NULL) {
+    cur->executable = file_reopen(parent->executable);
+    if (cur->executable != NULL) file_deny_write(cur->executable);
+  }
+  lock_release(&filesys_lock);
+  if (i < FD_TABLE_SIZE || cur->executable == NULL) return false;
+
+  cur->esp = parent->esp;
+  cur->data_segment_start = parent->data_segment_start;
+  cur->heap_start = parent->heap_start;
+  cur->brk = parent->brk;
+  cur->rss_limit = parent->rss_limit;
+
+  // Mappings, with their pages.
+  for (e = list_begin(&parent->mmap_table); e != list_end(&parent->mmap_table);
+       e = list_next(e)) {
+    struct mapping* pm = list_entry(e, struct mapping, elem);
+    struct mapping* m = malloc(sizeof(struct mapping));
+    struct list_elem* pe;
+
+    if (m == NULL) return false;
+    *m = *pm;
+    list_init(&m->pages);
+    list_push_back(&cur->mmap_table, &m->elem);
+    // An anonymous mapping has no file.
+    m->file = pm->file ? file_reopen(pm->file) : NULL;
+    if (pm->file && m->file == NULL) return false;
+
+    pa = area_find(parent, pm->addr);
+    a = area_insert(cur, m->file, pa->ofs, pa->start, pm->size, pa->file_bytes,
+                    pa->writable, pa->purpose);
+    if (a == NULL) return false;
+    a->mapping = m;
+
+    for (pe = list_begin(&pm->pages); pe != list_end(&pm->pages);
+         pe = list_next(pe))
+      if (!fork_page(list_entry(pe, struct page, MMAP_elem), m->file,
+                     &m->pages))
+        return false;
+  }
+
+  // The executable's segments, and the heap.
+  for (pa = area_next(parent, NULL); pa != NULL; pa = area_next(parent, pa->end))
+    if (pa->mapping == NULL &&
+        area_insert(cur, pa->file ? cur->executable : NULL, pa->ofs,
+                    pa->start, (uint8_t*)pa->end - (uint8_t*)pa->start,
+                    pa->file_bytes, pa->writable, pa->purpose) == NULL)
+      return false;
+
+  // Everything else that has a page: code, data, heap, stack and
+  // anonymous mappings.
+  ohash_first(&it, &parent->SPT);
+  while (ohash_next(&it)) {
+    struct page* p = ohash_entry(ohash_cur(&it), struct page, SPT_elem);
+    if (p->purpose == FOR_MMAP) continue;
+    if (!fork_page(p, p->purpose == FOR_FILE ? cur->executable : NULL, NULL))
+      return false;
+  }
+  return true;
+}
+
+/* A thread function that makes the running thread a copy of the
+   process that called fork() and starts it running. */
+static void start_fork(void* info_) {
+  struct fork_info* info = info_;
+  struct intr_frame if_ = info->if_;
+  bool success = fork_process(info->parent);
+
+  // fork() fails, so the parent never waits for this child: leave its
+  // children now (while it is blocked below) and exit without waiting
+  // to be reaped. process_exit() then frees what was copied at once.
+  if (!success) {
+    list_remove(&thread_current()->childelem);
+    thread_current()->parent = NULL;
+  }
+
+  // info lives on the parent's stack: done with it after this.
+  info->success = success;
+  sema_up(&info->done);
+  if (!success) thread_exit();
+
+  /* fork() returns 0 in the child. */
+  if_.eax = 0;
+  asm volatile("movl %0, %%esp; jmp intr_exit" : : "g"(&if_) : "memory");
+  NOT_REACHED();
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -211,7 +366,25 @@ int process_wait(tid_t child_tid) {
     if (t->tid == child_tid) {
       if (t->wait_status == true)  // If wait is already called, return -1
         return -1;
-      sema_down(&(t->child_sema));   // Wait until child process exiting
+      // Wait until child process exiting. If the OOM killer picks us
+      // meanwhile, it wakes us up to exit instead; process_exit() then
+      // waits again, with our memory freed (and nothing left to kill).
+      // Whoever wakes us clears waiting_for, with interrupts off, so
+      // child_sema is upped once per wakeup.
+      struct thread* cur = thread_current();
+      bool killable = cur->pagedir != NULL;
+      bool interrupted;
+      enum intr_level old_level = intr_disable();
+      if (killable && cur->oom_killed) {
+        interrupted = true;
+      } else {
+        if (killable) cur->waiting_for = t;
+        sema_down(&(t->child_sema));
+        interrupted = cur->wait_interrupted;
+        cur->wait_interrupted = false;
+      }
+      intr_set_level(old_level);
+      if (interrupted) exit(-1);
       t->wait_status = true;         // Wait is already called
       exit_status = t->exit_status;  // Save exit status
       sema_up(&(t->exit_sema));      // Now, we can remove childelem
@@ -235,17 +408,17 @@ void process_exit(void) {
     munmap_write(cur, m->id, false);
   }
 
-  // release lock & remove childelem before destroying pd
-  sema_up(&(cur->child_sema));
-  sema_down(&(cur->exit_sema));
-  list_remove(&(cur->childelem));
+  // Destroy the current process's SPT, mmapped pages included, in one
+  // pass. (Before closing the files: the page cache keys shared frames
+  // by inode.)
+  SPT_destroy();
 
   // Destroy all mappings
-  // printf("[Thread %s is calling munmap!]\n", thread_name());
-  for (e = list_begin(&cur->mmap_table); e != list_end(&cur->mmap_table);
-       e = list_next(e)) {
-    struct mapping* m = list_entry(e, struct mapping, elem);
-    munmap_free(cur, m->id);
+  while (!list_empty(&cur->mmap_table)) {
+    struct mapping* m =
+        list_entry(list_pop_front(&cur->mmap_table), struct mapping, elem);
+    file_close(m->file);
+    free(m);
   }
 
   // Close files that process opened
@@ -263,16 +436,6 @@ void process_exit(void) {
     cur->executable = NULL;
   }
 
-  // Destroy the current process's SPT.
-  SPT_destroy();
-
-  // Call wait for all children
-  for (e = list_begin(&(thread_current()->children));
-       e != list_end(&(thread_current()->children)); e = list_next(e)) {
-    struct thread* t = list_entry(e, struct thread, childelem);
-    process_wait(t->tid);
-  }
-
   /* Destroy the current process's page directory and switch back
    to the kernel-only page directory. */
   pd = cur->pagedir;
@@ -286,7 +449,29 @@ void process_exit(void) {
        that's been freed (and cleared). */
     cur->pagedir = NULL;
     pagedir_activate(NULL);
-    pagedir_destroy(pd);
+    pagedir_destroy_tables(pd);
+  }
+
+  free(cur->fault_stats);
+  cur->fault_stats = NULL;
+
+  // Only now, with its memory and files freed, wait to be reaped: the
+  // parent may take its time, and the OOM killer waits for this.
+  // (Unless a failed fork() child, which has no parent any more.)
+  if (cur->parent != NULL) {
+    enum intr_level old_level = intr_disable();
+    if (cur->parent->waiting_for == cur) cur->parent->waiting_for = NULL;
+    sema_up(&(cur->child_sema));
+    intr_set_level(old_level);
+    sema_down(&(cur->exit_sema));
+    list_remove(&(cur->childelem));
+  }
+
+  // Call wait for all children
+  for (e = list_begin(&(thread_current()->children));
+       e != list_end(&(thread_current()->children)); e = list_next(e)) {
+    struct thread* t = list_entry(e, struct thread, childelem);
+    process_wait(t->tid);
   }
 }
 
@@ -453,12 +638,17 @@ bool load(const char* file_name, void (**eip)(void), void** esp) {
           if (!load_segment(file, file_page, (void*)mem_page, read_bytes,
                             zero_bytes, writable))
             goto done;
+          /* The heap starts above the highest segment. */
+          if ((void*)(mem_page + read_bytes + zero_bytes) > t->heap_start)
+            t->heap_start = (void*)(mem_page + read_bytes + zero_bytes);
         } else
           goto done;
         break;
     }
   }
 
+  t->brk = t->heap_start;
+
   /* Set up stack. */
   if (!setup_stack(esp)) goto done;
 
@@ -547,47 +737,24 @@ static bool load_segment(struct file* file, off_t ofs, uint8_t* upage,
   ASSERT(pg_ofs(upage) == 0);
   ASSERT(ofs % PGSIZE == 0);
 
-  file_seek(file, ofs);
-  while (read_bytes > 0 || zero_bytes > 0) {
-    /* Calculate how to fill this page.
-       We will read PAGE_READ_BYTES bytes from FILE
-       and zero the final PAGE_ZERO_BYTES bytes. */
-    size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-    size_t page_zero_bytes = PGSIZE - page_read_bytes;
-    /*
-
-    // Get a page of memory.
-    uint8_t* kpage = frame_alloc(PAL_USER);
-    // uint8_t* kpage = palloc_get_page(PAL_USER);
-    // frame_add(upage, kpage);
-    if (kpage == NULL) return false;
-
-    // Load this page.
-    if (file_read(file, kpage, page_read_bytes) != (int)page_read_bytes) {
-      frame_free(kpage);
-      return false;
-    }
-    memset(kpage + page_read_bytes, 0, page_zero_bytes);
-
-    // Add the page to the process's address space.
-    if (!install_page(upage, kpage, writable)) {
-      frame_free(kpage);
-      return false;
-    }
-
-    */
+  struct thread* t = thread_current();
 
-    /* Insert page info to SPT. */
-    SPT_insert(file, ofs, upage, NULL, page_read_bytes, page_zero_bytes,
-               writable, FOR_FILE);
+  /* A page that the previous segment already covers keeps that
+     segment's contents. */
+  while ((read_bytes > 0 || zero_bytes > 0) && area_find(t, upage) != NULL) {
+    size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
 
-    /* Advance. */
     ofs += page_read_bytes;
     read_bytes -= page_read_bytes;
-    zero_bytes -= page_zero_bytes;
+    zero_bytes -= PGSIZE - page_read_bytes;
     upage += PGSIZE;
   }
-  return true;
+  if (read_bytes == 0 && zero_bytes == 0) return true;
+
+  /* One VM area for the rest.  Its pages are only created, and read,
+     when they are first touched; see SPT_get(). */
+  return area_insert(t, file, ofs, upage, read_bytes + zero_bytes,
+                     read_bytes, writable, FOR_FILE) != NULL;
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
@@ -1,25 +1,48 @@
 #include "userprog/syscall.h"
 
-#include <hash.h>
+#include <mman.h>
+#include <ohash.h>
+#include <round.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
 
 #include "devices/shutdown.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "userprog/exception.h"
 #include "userprog/pagedir.h"
 #include "userprog/process.h"
+#include "userprog/uaccess.h"
+#include "vm/area.h"
 #include "vm/frame.h"
 #include "vm/mmap.h"
 #include "vm/page.h"
+#include "vm/swap.h"
 
 static void syscall_handler(struct intr_frame*);
 
+// Most of a user buffer read() or write() pins at once.
+#define IO_PIN_BYTES (16 * PGSIZE)
+
+// Number of argument words each system call takes.
+static const uint8_t arg_cnt[] = {
+    [SYS_HALT] = 0,     [SYS_EXIT] = 1,     [SYS_EXEC] = 1,
+    [SYS_WAIT] = 1,     [SYS_CREATE] = 2,   [SYS_REMOVE] = 1,
+    [SYS_OPEN] = 1,     [SYS_FILESIZE] = 1, [SYS_READ] = 3,
+    [SYS_WRITE] = 3,    [SYS_SEEK] = 2,     [SYS_TELL] = 1,
+    [SYS_CLOSE] = 1,    [SYS_MMAP] = 2,     [SYS_MUNMAP] = 1,
+    [SYS_MEMSTAT] = 1,  [SYS_FORK] = 0,     [SYS_MADVISE] = 3,
+    [SYS_MSYNC] = 1,    [SYS_FAULTSTAT] = 1, [SYS_RSSLIMIT] = 1,
+    [SYS_SBRK] = 1,     [SYS_MMAP_ANON] = 2,
+};
+
 void syscall_init(void) {
   intr_register_int(0x30, 3, INTR_ON, syscall_handler, "syscall");
   lock_init(&filesys_lock);
@@ -73,27 +96,35 @@ int read(int fd, void* buffer, unsigned size) {
     exit(-1);
     return -1;
   }
-  int j;
-  for (j = 0; j < size; j++) touch_addr(buffer + j);
+  if (!is_user_range(buffer, size)) exit(-1);
 
-  lock_acquire(&filesys_lock);
-  if (fd == 0) {
-    int i;
-    int* buffer_c = buffer;
-    for (i = 0; i < size; i++) buffer_c[i] = input_getc();
-    lock_release(&filesys_lock);
-    return size;
+  struct file* f = NULL;
+  if (fd != 0) {
+    f = thread_current()->fd_table[fd];
+    if (f == NULL) return -1;  // error
   }
 
-  struct file** fd_table = thread_current()->fd_table;
-  struct file* f = fd_table[fd];
-  if (f == NULL) {
-    lock_release(&filesys_lock);
-    return -1;  // error
+  // Read straight into the user buffer, IO_PIN_BYTES at a time, with its
+  // pages pinned so that nothing faults while filesys_lock is held.
+  unsigned done = 0;
+  while (done < size) {
+    uint8_t* ubuf = (uint8_t*)buffer + done;
+    unsigned chunk = size - done < IO_PIN_BYTES ? size - done : IO_PIN_BYTES;
+    unsigned n, i;
+    if (!pin_user_range(ubuf, chunk, true)) exit(-1);
+    if (fd == 0) {
+      for (i = 0; i < chunk; i++) ubuf[i] = input_getc();
+      n = chunk;
+    } else {
+      lock_acquire(&filesys_lock);
+      n = file_read(f, ubuf, chunk);
+      lock_release(&filesys_lock);
+    }
+    unpin_user_range(ubuf, chunk);
+    done += n;
+    if (n < chunk) break;  // end of file
   }
-  int ret = file_read(f, buffer, size);
-  lock_release(&filesys_lock);
-  return ret;
+  return done;
 }
 
 int write(int fd, void* buffer, unsigned size) {
@@ -101,27 +132,34 @@ int write(int fd, void* buffer, unsigned size) {
     exit(-1);
     return -1;
   }
-  int j;
-  for (j = 0; j < size; j++) touch_addr(buffer + j);
+  if (!is_user_range(buffer, size)) exit(-1);
 
-  lock_acquire(&filesys_lock);
-  if (fd == 1) {
-    putbuf(buffer, size);
-    lock_release(&filesys_lock);
-    return size;
-  } else {
-    struct file** fd_table = thread_current()->fd_table;
-    struct file* f = fd_table[fd];
-    if (f == NULL) {
+  struct file* f = NULL;
+  if (fd != 1) {
+    f = thread_current()->fd_table[fd];
+    if (f == NULL) return -1;  // error
+  }
+
+  // As in read(): straight from the pinned user buffer.
+  unsigned done = 0;
+  while (done < size) {
+    uint8_t* ubuf = (uint8_t*)buffer + done;
+    unsigned chunk = size - done < IO_PIN_BYTES ? size - done : IO_PIN_BYTES;
+    unsigned n;
+    if (!pin_user_range(ubuf, chunk, false)) exit(-1);
+    if (fd == 1) {
+      putbuf((const char*)ubuf, chunk);
+      n = chunk;
+    } else {
+      lock_acquire(&filesys_lock);
+      n = file_write(f, ubuf, chunk);
       lock_release(&filesys_lock);
-      return -1;  // error
     }
-    int ret = file_write(f, buffer, size);
-    lock_release(&filesys_lock);
-    return ret;
+    unpin_user_range(ubuf, chunk);
+    done += n;
+    if (n < chunk) break;  // file cannot grow
   }
-  lock_release(&filesys_lock);
-  return -1;
+  return done;
 }
 
 void seek(int fd, unsigned position) {
@@ -163,77 +201,160 @@ void close(int fd) {
   }
 }
 
-/* A function which checks if a virtual address is valid.
-   If not, the thread exits with exit code -1 */
-void check_valid(void* addr) {
-  uint32_t* current_pd = thread_current()->pagedir;
-  if (!addr || !is_user_vaddr(addr) || !pagedir_get_page(current_pd, addr)) {
+/* Copy a snapshot of kernel memory usage to user buffer STATS. */
+bool memstat(struct memstat* stats) {
+  struct memstat snapshot;
+
+  palloc_get_stats(&snapshot);
+  malloc_get_stats(&snapshot);
+  SD_get_stats(&snapshot.swap);
+  if (stats == NULL || !copy_to_user(stats, &snapshot, sizeof snapshot))
     exit(-1);
-    return;
-  }
+  return true;
 }
 
-/* Cause page fault by "touching". This forces lazy-load to actually load
- * something in that page.*/
-void touch_addr(void* addr) {
-  uint8_t* temp_addr = (void*)addr;
-  volatile uint8_t touch = *temp_addr;
+/* Copy the page fault statistics of this process and of the whole
+ * system to user buffer STATS. */
+bool faultstat(struct faultstat* stats) {
+  struct faultstat* snapshot;
+  bool ok;
+
+  if (stats == NULL || !is_user_range(stats, sizeof *stats)) exit(-1);
+
+  // Too big for the kernel stack.
+  snapshot = malloc(sizeof *snapshot);
+  if (snapshot == NULL) return false;
+  exception_get_stats(snapshot);
+  ok = copy_to_user(stats, snapshot, sizeof *snapshot);
+  free(snapshot);
+  if (!ok) exit(-1);
+  return true;
 }
 
-/* Map files into process address space */
-int mmap(int fd, void* addr) {
-  // Validation
-  if (fd == 0 || fd == 1 || addr == NULL) return -1;
-  if (pg_ofs(addr) != 0) return -1;
+/* Set this process's resident-set limit to PAGES frames (0: the system
+ * default) and return the previous limit. */
+size_t rsslimit(size_t pages) {
   struct thread* t = thread_current();
-  struct file** fd_table = t->fd_table;
-  struct file* f = fd_table[fd];
-  if (f == NULL) return -1;
-  off_t len = file_length(f);
-  if (len == 0) return -1;
-  // The range of pages mapped overlaps any exisitng set of mapped pages -> fail
-  if (find_mapping_addr(&t->mmap_table, addr) != NULL) return -1;
+  size_t old = t->rss_limit;
+
+  t->rss_limit = pages;
+  return old;
+}
+
+/* Adds a mapping of LEN bytes at ADDR to T: of FILE (opened as FD),
+   or of demand-zero memory if FILE is null. Returns its id, or -1 if
+   the range is bad or taken. */
+static int map_area(struct thread* t, struct file* file, int fd, void* addr,
+                    size_t len) {
+  if (addr == NULL || pg_ofs(addr) != 0 || len == 0) return -1;
   if (addr >= PHYS_BASE - PGSIZE || addr <= t->data_segment_start) return -1;
+  // The range of pages mapped overlaps any existing area -> fail
+  void* end = addr + ROUND_UP(len, PGSIZE);
+  if (end <= addr || !is_user_vaddr(end - 1)) return -1;
+  if (area_overlaps(t, addr, end)) return -1;
 
   // Insert mapping to mmap_table
   struct mapping* m = malloc(sizeof(struct mapping));
+  if (m == NULL) return -1;
   m->id = list_size(&t->mmap_table) + 1;
   m->addr = addr;
   m->size = len;
-  m->file = file_reopen(f);
+  m->file = file ? file_reopen(file) : NULL;
   m->fd = fd;
+  m->ra_window = 0;
+  m->ra_next = addr;
+  m->advice = MADV_NORMAL;
   list_init(&m->pages);
   list_push_back(&t->mmap_table, &m->elem);
 
-  // Page-wise file mapping
-  off_t read_bytes = len;
-  off_t ofs = 0;
-  while (read_bytes > 0) {
-    off_t page_read_bytes = PGSIZE, page_zero_bytes;
-    if (read_bytes < PGSIZE) page_read_bytes = read_bytes;
-    page_zero_bytes = PGSIZE - page_read_bytes;
-
-    uint8_t* kpage = palloc_get_page(0);
-    struct page *temp = SPT_insert(m->file, ofs, addr, kpage, page_read_bytes, page_zero_bytes,
-               true, FOR_MMAP);
-    list_push_back(&m->pages, &temp->MMAP_elem);
-
-    if (file_read(m->file, kpage, page_read_bytes) != page_read_bytes) {
-      ASSERT(0);
-      palloc_free_page(kpage);
-      return -1;
-    }
-    memset(kpage + page_read_bytes, 0, page_zero_bytes);
-
-    read_bytes -= page_read_bytes;
-    addr += PGSIZE;
-    ofs += page_read_bytes;
+  // One area for the whole range. Nothing is read or allocated per page
+  // here: the page fault handler creates and fills each page from the
+  // file (or with zeros) when it is first touched.
+  struct vm_area* a =
+      area_insert(t, m->file, 0, addr, len, file ? len : 0, true,
+                  file ? FOR_MMAP : FOR_ANON);
+  if (a == NULL) {
+    list_remove(&m->elem);
+    file_close(m->file);
+    free(m);
+    return -1;
   }
+  a->mapping = m;
 
   // return mapping id
   return m->id;
 }
 
+/* Map files into process address space */
+int mmap(int fd, void* addr) {
+  // Validation
+  if (fd == 0 || fd == 1) return -1;
+  struct thread* t = thread_current();
+  struct file* f = t->fd_table[fd];
+  if (f == NULL) return -1;
+  off_t len = file_length(f);
+  if (len == 0) return -1;
+  return map_area(t, f, fd, addr, len);
+}
+
+/* Map LENGTH bytes of demand-zero memory, backed by no file, at
+   ADDR. Its pages go to swap when evicted. */
+int mmap_anon(void* addr, size_t length) {
+  return map_area(thread_current(), NULL, -1, addr, length);
+}
+
+/* Frees T's pages in [START, END), with their frames or swap slots,
+   and their SPT entries. */
+static void free_pages(struct thread* t, void* start, void* end) {
+  uint8_t* upage;
+
+  for (upage = start; upage < (uint8_t*)end; upage += PGSIZE) {
+    struct page* p = SPT_search(t, upage);
+    if (p == NULL) continue;
+    frame_drop(p);
+    ohash_delete(&t->SPT, &p->SPT_elem);
+    free(p);
+  }
+}
+
+/* Move the program break by INCREMENT bytes and return the old one,
+   or (void*)-1 if the heap would go below its start or run into
+   another area or the stack. Heap pages are demand-zero; the ones
+   left wholly above a lowered break are freed. */
+void* sbrk(intptr_t increment) {
+  struct thread* t = thread_current();
+  uint8_t* old_brk = t->brk;
+  uint8_t* new_brk = old_brk + increment;
+  void* old_end = pg_round_up(old_brk);
+  void* new_end = pg_round_up(new_brk);
+  struct vm_area* a =
+      old_end > t->heap_start ? area_find(t, t->heap_start) : NULL;
+
+  // The stack may grow down to 8 MB below PHYS_BASE.
+  if ((increment > 0 && new_brk < old_brk) ||
+      (increment < 0 && new_brk > old_brk) ||
+      new_brk < (uint8_t*)t->heap_start ||
+      new_brk > (uint8_t*)PHYS_BASE - 0x800000)
+    return (void*)-1;
+
+  if (new_end > old_end) {
+    if (a == NULL) {
+      a = area_insert(t, NULL, 0, t->heap_start, new_end - t->heap_start, 0,
+                      true, FOR_ANON);
+      if (a == NULL) return (void*)-1;
+    } else if (!area_resize(t, a, new_end))
+      return (void*)-1;
+  } else if (new_end < old_end) {
+    free_pages(t, new_end, old_end);
+    if (new_end == t->heap_start)
+      area_remove(t, a);
+    else
+      area_resize(t, a, new_end);
+  }
+  t->brk = new_brk;
+  return old_brk;
+}
+
 /* Write mapping's content to the file */
 void munmap_write(struct thread* t, int mapping, bool unmap) {
   struct mapping* m = find_mapping_id(&t->mmap_table, mapping);
@@ -241,14 +362,9 @@ void munmap_write(struct thread* t, int mapping, bool unmap) {
 
   // Check whether the pages are dirty. If so, call `file_write_at`
   struct list_elem* e;
-  // struct frame* f;
-  struct hash* spt = &t->SPT;
-  struct hash_iterator it;
-  hash_first(&it, spt);
   lock_acquire(&filesys_lock);
-  while (hash_next(&it)) {
-    struct page* p = hash_entry(hash_cur(&it), struct page, SPT_elem);
-    if (p->purpose != FOR_MMAP) continue;
+  for (e = list_begin(&m->pages); e != list_end(&m->pages); e = list_next(e)) {
+    struct page* p = list_entry(e, struct page, MMAP_elem);
     void* addr = p->page_addr;
     if (pagedir_is_dirty(t->pagedir, addr))
       file_write_at(p->page_file, p->page_addr, p->read_bytes, p->ofs);
@@ -266,15 +382,22 @@ void munmap_free(struct thread* t, int mapping) {
   // Close reopened file
   // file_close(m->file);
 
+  struct vm_area* a = area_find(t, m->addr);
+
+  // An anonymous mapping's pages are not on m->pages: free them by
+  // address, swap slots included.
+  if (m->file == NULL) free_pages(t, a->start, a->end);
+
   // free mapping with unmapping page, clearing spt, free frame entry, ...
   struct list_elem* e;
   for (e = list_begin(&m->pages); e != list_end(&m->pages); e = list_next(e)) {
     struct page* p = list_entry(e, struct page, MMAP_elem);
-    frame_free(p->page_addr);
     pagedir_clear_page(t->pagedir, p->page_addr);
+    frame_release(p);
     // SPT_remove(p->page_addr);
-    hash_delete(&t->SPT, &p->SPT_elem);
+    ohash_delete(&t->SPT, &p->SPT_elem);
   }
+  area_remove(t, a);
   list_remove(&m->elem);
   free(m);
 
@@ -350,23 +473,110 @@ void munmap(int mapping) {
   munmap_free(t, mapping);
 }
 
+/* Give advice ADVICE (see <mman.h>) about the LENGTH bytes at ADDR,
+   which must be page-aligned. Sequential/random advice applies to
+   the mappings the range touches; the rest acts on each page. */
+bool madvise(void* addr, size_t length, int advice) {
+  struct thread* t = thread_current();
+  uint8_t* upage;
+  uint8_t* end = (uint8_t*)addr + length;
+
+  if (pg_ofs(addr) != 0 || length == 0 || end < (uint8_t*)addr ||
+      !is_user_vaddr(end - 1))
+    return false;
+  if (advice < MADV_NORMAL || advice > MADV_DONTNEED) return false;
+
+  for (upage = addr; upage < end; upage += PGSIZE) {
+    struct page* p;
+    struct mapping* m;
+
+    switch (advice) {
+      case MADV_NORMAL:
+      case MADV_RANDOM:
+      case MADV_SEQUENTIAL:
+        m = find_mapping_addr(t, upage);
+        if (m) m->advice = advice;
+        break;
+
+      case MADV_WILLNEED:
+        // Only file-backed pages, and only into free frames: advice
+        // should not push out memory that is in use.
+        if (frame_pool_low()) break;
+        p = SPT_get(t, upage);
+        if (p && (p->purpose == FOR_FILE || p->purpose == FOR_MMAP))
+          exception_prefetch(p);
+        break;
+
+      case MADV_DONTNEED:
+        // A page that was never created has nothing to drop.
+        p = SPT_search(t, upage);
+        if (p) frame_drop(p);
+        break;
+    }
+  }
+  return true;
+}
+
+/* Write the dirty pages of MAPPING back to its file, keeping them
+   mapped. Returns false if there is no such mapping. */
+bool msync(int mapping) {
+  struct mapping* m = find_mapping_id(&thread_current()->mmap_table, mapping);
+  struct list_elem* e;
+
+  if (m == NULL) return false;
+  for (e = list_begin(&m->pages); e != list_end(&m->pages); e = list_next(e))
+    frame_sync(list_entry(e, struct page, MMAP_elem));
+  return true;
+}
+
+/* Copies the string at user address USTR into a new page, which the
+ * caller frees. Kills the process if USTR is not readable; a string too
+ * long for the page is cut short. */
+static char* copy_in_string(const char* ustr) {
+  char* page = palloc_get_page(0);
+  int len;
+
+  if (page == NULL) exit(-1);
+  len = strncpy_from_user(page, ustr, PGSIZE);
+  if (len < 0) {
+    palloc_free_page(page);
+    exit(-1);
+  }
+  if (len == PGSIZE) page[PGSIZE - 1] = '\0';
+  return page;
+}
+
 static void syscall_handler(struct intr_frame* f) {
-  // printf("case: %d\n", *(uint32_t*)f->esp);
+  uint32_t nr;       // system call number.
+  uint32_t args[3];  // its arguments.
+  char* name;        // a string argument, copied in.
+
+  // Page faults in the kernel grow the stack relative to this.
+  thread_current()->esp = f->esp;
 
   // Before handling system call:
-  // Check if the stack pointer is valid (sc-bad-sp)
-  check_valid(f->esp);
+  // Copy in the number and the arguments it takes; a bad stack pointer
+  // (sc-bad-sp) or argument (sc-bad-arg) kills the process.
+  if (!copy_from_user(&nr, f->esp, sizeof nr)) exit(-1);
+  if (nr < sizeof arg_cnt / sizeof *arg_cnt &&
+      !copy_from_user(args, (uint32_t*)f->esp + 1, arg_cnt[nr] * sizeof *args))
+    exit(-1);
+
+  // Chosen by the OOM killer (see vm/frame.c): die now.
+  if (thread_current()->oom_killed) exit(-1);
+
+  // Close files reopened by evictions (in case kswapd is not running).
+  frame_close_deferred();
 
   // handling system call
-  switch (*(uint32_t*)f->esp) {
+  switch (nr) {
     case SYS_HALT:
       shutdown_power_off();
       break;
 
     case SYS_EXIT:
-      check_valid(f->esp + 4);
-      f->eax = *(uint32_t*)(f->esp + 4);  // update return value
-      exit(*(uint32_t*)(f->esp + 4));
+      f->eax = args[0];  // update return value
+      exit(args[0]);
       break;
 
     case SYS_EXEC:
@@ -377,18 +587,12 @@ static void syscall_handler(struct intr_frame* f) {
 
       // tid_t process_execute(const char* file_name) // in process.c
 
-      check_valid(f->esp + 4);
-
-      if (!pagedir_get_page((uint32_t*)thread_current()->pagedir,
-                            (const void*)*(uint32_t*)(f->esp + 4))) {
-        f->eax = -1;
-        exit(-1);
-        return;
-      }
+      name = copy_in_string((const char*)args[0]);
 
       tid_t pid;
       lock_acquire(&filesys_lock);
-      pid = process_execute((const void*)*(uint32_t*)(f->esp + 4));
+      pid = process_execute(name);
+      palloc_free_page(name);
 
       // Search point to thread created, then wait for its loading
       // If the loading failed, return value should become -1
@@ -416,8 +620,7 @@ static void syscall_handler(struct intr_frame* f) {
 
       // int process_wait(tid_t child_tid) // in process.c
 
-      check_valid(f->esp + 4);
-      f->eax = process_wait((tid_t) * (uint32_t*)(f->esp + 4));
+      f->eax = process_wait((tid_t)args[0]);
       break;
 
     case SYS_CREATE:
@@ -426,23 +629,13 @@ static void syscall_handler(struct intr_frame* f) {
       // Creates a new file called file initially initial size bytes in size.
       // Returns true if successful, false otherwise.
 
-      check_valid(f->esp + 4);
-      check_valid(f->esp + 8);
-
-      if (!is_user_vaddr((void*)*(uint32_t*)(f->esp + 4)) ||
-          !pagedir_get_page((uint32_t*)thread_current()->pagedir,
-                            (const void*)*(uint32_t*)(f->esp + 4))) {
-        f->eax = -1;  // return 0 (false)
-        exit(-1);
-        return;
-      }
-
-      if (filesys_create((const char*)*(uint32_t*)(f->esp + 4),
-                         (unsigned)*((uint32_t*)(f->esp + 8)))) {
+      name = copy_in_string((const char*)args[0]);
+      if (filesys_create(name, (unsigned)args[1])) {
         f->eax = 1;  // return 1 (true)
       } else {
         f->eax = 0;  // return 0 (false)
       }
+      palloc_free_page(name);
       break;
 
     case SYS_REMOVE:
@@ -454,18 +647,9 @@ static void syscall_handler(struct intr_frame* f) {
 
       // bool filesys_remove(const char* name) // in filesys.c
 
-      check_valid(f->esp + 4);
-
-      if (!is_user_vaddr((void*)*(uint32_t*)(f->esp + 4)) ||
-          !pagedir_get_page((uint32_t*)thread_current()->pagedir,
-                            (const void*)*(uint32_t*)(f->esp + 4))) {
-        f->eax = -1;  // return -1 (error)
-        exit(-1);
-        return;
-      }
-
-      f->eax = filesys_remove((const char*)*(uint32_t*)(f->esp + 4));
-
+      name = copy_in_string((const char*)args[0]);
+      f->eax = filesys_remove(name);
+      palloc_free_page(name);
       break;
 
     case SYS_OPEN:
@@ -474,17 +658,9 @@ static void syscall_handler(struct intr_frame* f) {
       // Opens the file called file. Returns a nonnegative integer handle called
       // a “file descriptor” (fd), or -1 if the file could not be opened.
 
-      check_valid(f->esp + 4);
-
-      if (!is_user_vaddr((void*)*(uint32_t*)(f->esp + 4)) ||
-          !pagedir_get_page((uint32_t*)thread_current()->pagedir,
-                            (const void*)*(uint32_t*)(f->esp + 4))) {
-        f->eax = -1;  // return -1 (error)
-        exit(-1);
-        return;
-      }
-
-      f->eax = open((const char*)*(uint32_t*)(f->esp + 4));
+      name = copy_in_string((const char*)args[0]);
+      f->eax = open(name);
+      palloc_free_page(name);
       break;
 
     case SYS_FILESIZE:
@@ -493,8 +669,7 @@ static void syscall_handler(struct intr_frame* f) {
       // Returns the size, in bytes, of the file open as fd.
 
       // struct inode_disk has member: off_t length, which is file size in bytes
-      check_valid(f->esp + 4);
-      f->eax = filesize((int)*(uint32_t*)(f->esp + 4));
+      f->eax = filesize((int)args[0]);
 
       break;
 
@@ -509,23 +684,7 @@ static void syscall_handler(struct intr_frame* f) {
       // off_t file_read(struct file* file, void* buffer, off_t size) // in
       // file.c
 
-      check_valid(f->esp + 4);
-      check_valid(f->esp + 8);
-      check_valid(f->esp + 12);
-
-      touch_addr((const void*)*(uint32_t*)(f->esp + 8));
-
-      if (!is_user_vaddr((void*)*(uint32_t*)(f->esp + 8)) ||
-          !pagedir_get_page((uint32_t*)thread_current()->pagedir,
-                            (const void*)*(uint32_t*)(f->esp + 8))) {
-        f->eax = -1;  // return -1 (false)
-        exit(-1);
-        return;
-      }
-
-      f->eax =
-          read((int)*(uint32_t*)(f->esp + 4), (void*)*(uint32_t*)(f->esp + 8),
-               (unsigned)*((uint32_t*)(f->esp + 12)));
+      f->eax = read((int)args[0], (void*)args[1], (unsigned)args[2]);
 
       break;
 
@@ -539,23 +698,7 @@ static void syscall_handler(struct intr_frame* f) {
       // off_t file_write(struct file* file, const void* buffer, off_t size) //
       // in file.c
 
-      check_valid(f->esp + 4);
-      check_valid(f->esp + 8);
-      check_valid(f->esp + 12);
-
-      touch_addr((const void*)*(uint32_t*)(f->esp + 8));
-
-      if (!is_user_vaddr((void*)*(uint32_t*)(f->esp + 8)) ||
-          !pagedir_get_page((uint32_t*)thread_current()->pagedir,
-                            (const void*)*(uint32_t*)(f->esp + 8))) {
-        f->eax = -1;  // return -1 (false)
-        exit(-1);
-        return;
-      }
-
-      f->eax =
-          write((int)*(uint32_t*)(f->esp + 4), (void*)*(uint32_t*)(f->esp + 8),
-                (unsigned)*((uint32_t*)(f->esp + 12)));
+      f->eax = write((int)args[0], (void*)args[1], (unsigned)args[2]);
       break;
 
     case SYS_SEEK:
@@ -566,10 +709,7 @@ static void syscall_handler(struct intr_frame* f) {
 
       // void file_seek(struct file* file, off_t new_pos) // in file.c
 
-      check_valid(f->esp + 4);
-      check_valid(f->esp + 8);
-
-      seek((int)*(uint32_t*)(f->esp + 4), (unsigned)*((uint32_t*)(f->esp + 8)));
+      seek((int)args[0], (unsigned)args[1]);
 
       break;
 
@@ -581,35 +721,74 @@ static void syscall_handler(struct intr_frame* f) {
 
       // off_t file_tell(struct file* file) // in file.c
 
-      check_valid(f->esp + 4);
-      check_valid(f->esp + 8);
-
-      f->eax = tell((int)*(uint32_t*)(f->esp + 4));
+      f->eax = tell((int)args[0]);
 
       break;
 
     case SYS_CLOSE:
-      check_valid(f->esp + 4);
-      close((int)*(uint32_t*)(f->esp + 4));
+      close((int)args[0]);
       break;
 
     case SYS_MMAP: /* Map a file into memory. */
       // mapid_t mmap(int fd, void *addr)
 
-      check_valid(f->esp + 4);
-      check_valid(f->esp + 8);
+      f->eax = mmap((int)args[0], (void*)args[1]);
+
+      break;
+
+    case SYS_MMAP_ANON: /* Map anonymous memory. */
+      // mapid_t mmap_anon(void *addr, size_t length);
 
-      f->eax =
-          mmap((int)*(uint32_t*)(f->esp + 4), (void*)*(uint32_t*)(f->esp + 8));
+      f->eax = mmap_anon((void*)args[0], (size_t)args[1]);
+      break;
+
+    case SYS_SBRK: /* Grow or shrink the heap. */
+      // void *sbrk(intptr_t increment);
 
+      f->eax = (uint32_t)sbrk((intptr_t)args[0]);
       break;
 
     case SYS_MUNMAP: /* Remove a memory mapping. */
       // void munmap(mapid_t mapping);
-      check_valid(f->esp + 4);
 
-      munmap((int)*(uint32_t*)(f->esp + 4));
+      munmap((int)args[0]);
+
+      break;
+
+    case SYS_MEMSTAT: /* Report kernel memory usage. */
+      // bool memstat(struct memstat *stats);
+
+      f->eax = memstat((struct memstat*)args[0]);
+
+      break;
+
+    case SYS_MADVISE: /* Advise on expected use of memory. */
+      // bool madvise(void *addr, size_t length, int advice);
+
+      f->eax = madvise((void*)args[0], (size_t)args[1], (int)args[2]);
+      break;
+
+    case SYS_MSYNC: /* Write a mapping back to its file. */
+      // bool msync(mapid_t mapping);
+
+      f->eax = msync((int)args[0]);
+      break;
+
+    case SYS_FAULTSTAT: /* Report page fault statistics. */
+      // bool faultstat(struct faultstat *stats);
+
+      f->eax = faultstat((struct faultstat*)args[0]);
+      break;
+
+    case SYS_RSSLIMIT: /* Set the resident-set limit. */
+      // size_t rsslimit(size_t pages);
+
+      f->eax = rsslimit((size_t)args[0]);
+      break;
 
+    case SYS_FORK: /* Duplicate this process. */
+      // pid_t fork(void);
+      f->eax = process_fork(f);
       break;
 
     default:
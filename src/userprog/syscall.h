@@ -1,10 +1,15 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include <faultstat.h>
+#include <memstat.h>
+#include <stdint.h>
+
 #include "threads/synch.h"
 #include "threads/thread.h"
 
 void syscall_init(void);
+void exit(int status);
 int open(const char* file);
 int filesize(int fd);
 int read(int fd, void* buffer, unsigned size);
@@ -13,11 +18,17 @@ void seek(int fd, unsigned position);
 unsigned tell(int fd);
 void close(int fd);
 
-void check_valid(void* addr);
 int mmap(int fd, void* addr);
+int mmap_anon(void* addr, size_t length);
+void* sbrk(intptr_t increment);
 void munmap_write(struct thread* t, int mapping, bool unmap);
 void munmap_free(struct thread* t, int mapping);
 void munmap(int mapping);
+bool memstat(struct memstat* stats);
+bool madvise(void* addr, size_t length, int advice);
+bool msync(int mapping);
+bool faultstat(struct faultstat* stats);
+size_t rsslimit(size_t pages);
 
 struct lock filesys_lock;
 
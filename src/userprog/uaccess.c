@@ -0,0 +1,118 @@
+#include "userprog/uaccess.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/frame.h"
+
+// Exception table entry: a page fault at insn that the fault handler
+// cannot resolve resumes at fixup.
+struct ex_entry {
+  uintptr_t insn;
+  uintptr_t fixup;
+};
+
+// The exception table, laid out by kernel.lds.S.
+extern const struct ex_entry _start_ex_table[], _end_ex_table[];
+
+// Copies size bytes from src to dst. Returns the number of bytes left
+// over: 0, unless an access faulted. A rep movsb that faults leaves its
+// count in ECX, and the fixup just goes on after it.
+static size_t copy_bytes(void* dst, const void* src, size_t size) {
+  asm volatile(
+      "1: rep movsb\n"
+      "2:\n"
+      ".section .ex_table, \"a\"\n"
+      ".long 1b, 2b\n"
+      ".previous"
+      : "+c"(size), "+D"(dst), "+S"(src)
+      :
+      : "memory");
+  return size;
+}
+
+bool is_user_range(const void* uaddr, size_t size) {
+  const uint8_t* p = uaddr;
+  return size == 0 || (p + size > p && is_user_vaddr(p + size - 1));
+}
+
+bool copy_from_user(void* dst, const void* usrc, size_t size) {
+  return is_user_range(usrc, size) && copy_bytes(dst, usrc, size) == 0;
+}
+
+bool copy_to_user(void* udst, const void* src, size_t size) {
+  return is_user_range(udst, size) && copy_bytes(udst, src, size) == 0;
+}
+
+int strncpy_from_user(char* dst, const char* usrc, size_t size) {
+  size_t len = 0;
+
+  // A page at a time, so as not to read past the page the string ends
+  // in.
+  while (len < size) {
+    size_t chunk = PGSIZE - pg_ofs(usrc + len);
+    char* nul;
+
+    if (chunk > size - len) chunk = size - len;
+    if (!copy_from_user(dst + len, usrc + len, chunk)) return -1;
+    nul = memchr(dst + len, '\0', chunk);
+    if (nul != NULL) return nul - dst;
+    len += chunk;
+  }
+  return size;
+}
+
+// Faults in the page of user address UADDR, for writing if WRITE, as an
+// access from the process would. Returns false if it is not accessible.
+static bool fault_in(uint8_t* uaddr, bool write) {
+  uint8_t byte;
+
+  // Writing the byte back changes nothing: the process is in a system
+  // call, so nothing else writes to its memory meanwhile.
+  return copy_from_user(&byte, uaddr, 1) &&
+         (!write || copy_to_user(uaddr, &byte, 1));
+}
+
+bool pin_user_range(void* uaddr, size_t size, bool write) {
+  uint8_t* start = pg_round_down(uaddr);
+  uint8_t* end = (uint8_t*)uaddr + size;
+  uint8_t* upage;
+
+  if (size == 0) return true;
+  if (!is_user_range(uaddr, size)) return false;
+  for (upage = start; upage < end; upage += PGSIZE) {
+    int tries = 0;
+
+    while (!frame_pin(upage, write)) {
+      // Present but not pinnable: being evicted or cleaned ahead.
+      if (tries++ > 0) thread_yield();
+      if (!fault_in(upage, write)) {
+        if (upage > start) unpin_user_range(start, upage - start);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void unpin_user_range(void* uaddr, size_t size) {
+  uint8_t* upage;
+
+  for (upage = pg_round_down(uaddr); upage < (uint8_t*)uaddr + size;
+       upage += PGSIZE)
+    frame_unpin(upage);
+}
+
+bool uaccess_fixup(struct intr_frame* f) {
+  const struct ex_entry* e;
+
+  for (e = _start_ex_table; e < _end_ex_table; e++)
+    if (e->insn == (uintptr_t)f->eip) {
+      f->eip = (void (*)(void))e->fixup;
+      return true;
+    }
+  return false;
+}
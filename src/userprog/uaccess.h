@@ -0,0 +1,49 @@
+#ifndef USERPROG_UACCESS_H
+#define USERPROG_UACCESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Copying to and from user memory.
+//
+// Nothing is checked or touched beforehand: the copy itself faults in
+// each page it needs, the page fault handler loads it as it would for
+// the process, and the copy goes on. If the address is bad instead, the
+// handler looks the faulting instruction up in the exception table (the
+// .ex_table section, see kernel.lds.S) and resumes at its fixup, which
+// makes the copy fail. So a copy costs at most one fault per page.
+
+struct intr_frame;
+
+// True if [uaddr, uaddr + size) lies wholly below PHYS_BASE.
+bool is_user_range(const void* uaddr, size_t size);
+
+// Copy size bytes from user address usrc to dst. Returns false if part
+// of the source is not readable user memory.
+bool copy_from_user(void* dst, const void* usrc, size_t size);
+
+// Copy size bytes from src to user address udst. Returns false if part
+// of the destination is not writable user memory.
+bool copy_to_user(void* udst, const void* src, size_t size);
+
+// Copy the string at user address usrc, with its null terminator, into
+// dst, which holds size bytes. Returns the string's length, size if it
+// does not fit (dst is then not terminated), or -1 if it is not readable
+// user memory.
+int strncpy_from_user(char* dst, const char* usrc, size_t size);
+
+// Pin the pages of the running process's buffer [uaddr, uaddr + size)
+// in memory (see frame_pin()), faulting each one in first as needed,
+// for writing if WRITE. The kernel can then access the buffer directly,
+// even with filesys_lock held. Returns false, with nothing pinned, if
+// part of it is not accessible user memory. Pin only a bounded number
+// of pages at once, since pinned frames cannot be evicted.
+bool pin_user_range(void* uaddr, size_t size, bool write);
+void unpin_user_range(void* uaddr, size_t size);
+
+// For the page fault handler, on a kernel-mode fault it cannot resolve:
+// if F faulted in a user copy, resumes F at the copy's fixup and returns
+// true.
+bool uaccess_fixup(struct intr_frame* f);
+
+#endif /* userprog/uaccess.h */
@@ -0,0 +1,181 @@
+#include "vm/area.h"
+
+#include <debug.h>
+#include <round.h>
+
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+static int height(struct vm_area* a) { return a ? a->height : 0; }
+
+static void update_height(struct vm_area* a) {
+  int l = height(a->left), r = height(a->right);
+  a->height = (l > r ? l : r) + 1;
+}
+
+static struct vm_area* rotate_right(struct vm_area* a) {
+  struct vm_area* b = a->left;
+  a->left = b->right;
+  b->right = a;
+  update_height(a);
+  update_height(b);
+  return b;
+}
+
+static struct vm_area* rotate_left(struct vm_area* a) {
+  struct vm_area* b = a->right;
+  a->right = b->left;
+  b->left = a;
+  update_height(a);
+  update_height(b);
+  return b;
+}
+
+// Restores the AVL property at a, whose subtrees differ in height by
+// at most 2. Returns the new root of the subtree.
+static struct vm_area* rebalance(struct vm_area* a) {
+  int balance = height(a->left) - height(a->right);
+
+  update_height(a);
+  if (balance > 1) {
+    if (height(a->left->left) < height(a->left->right))
+      a->left = rotate_left(a->left);
+    return rotate_right(a);
+  }
+  if (balance < -1) {
+    if (height(a->right->right) < height(a->right->left))
+      a->right = rotate_right(a->right);
+    return rotate_left(a);
+  }
+  return a;
+}
+
+static struct vm_area* tree_insert(struct vm_area* root, struct vm_area* a) {
+  if (!root) return a;
+  if (a->start < root->start)
+    root->left = tree_insert(root->left, a);
+  else
+    root->right = tree_insert(root->right, a);
+  return rebalance(root);
+}
+
+// Unlinks the lowest area below root into *min.
+static struct vm_area* remove_min(struct vm_area* root, struct vm_area** min) {
+  if (!root->left) {
+    *min = root;
+    return root->right;
+  }
+  root->left = remove_min(root->left, min);
+  return rebalance(root);
+}
+
+static struct vm_area* tree_remove(struct vm_area* root, struct vm_area* a) {
+  struct vm_area* min;
+
+  if (!root) return NULL;
+  if (a->start < root->start)
+    root->left = tree_remove(root->left, a);
+  else if (a->start > root->start)
+    root->right = tree_remove(root->right, a);
+  else {
+    if (!root->right) return root->left;
+    root->right = remove_min(root->right, &min);
+    min->left = root->left;
+    min->right = root->right;
+    root = min;
+  }
+  return rebalance(root);
+}
+
+// The area with the greatest start at or below addr, or NULL.
+static struct vm_area* floor_area(struct vm_area* n, const void* addr) {
+  struct vm_area* best = NULL;
+
+  while (n) {
+    if (n->start <= addr) {
+      best = n;
+      n = n->right;
+    } else
+      n = n->left;
+  }
+  return best;
+}
+
+static void tree_destroy(struct vm_area* a) {
+  if (!a) return;
+  tree_destroy(a->left);
+  tree_destroy(a->right);
+  free(a);
+}
+
+struct vm_area* area_insert(struct thread* t, struct file* file, off_t ofs,
+                            void* start, size_t size, size_t file_bytes,
+                            bool writable, enum page_purpose purpose) {
+  void* end = (uint8_t*)start + ROUND_UP(size, PGSIZE);
+  struct vm_area* a;
+
+  ASSERT(pg_ofs(start) == 0);
+  ASSERT(file_bytes <= size);
+  if (size == 0 || end < start || area_overlaps(t, start, end)) return NULL;
+
+  a = malloc(sizeof *a);
+  if (!a) return NULL;
+  a->start = start;
+  a->end = end;
+  a->file = file;
+  a->ofs = ofs;
+  a->file_bytes = file_bytes;
+  a->writable = writable;
+  a->purpose = purpose;
+  a->mapping = NULL;
+  a->left = a->right = NULL;
+  a->height = 1;
+  t->areas = tree_insert(t->areas, a);
+  return a;
+}
+
+void area_remove(struct thread* t, struct vm_area* a) {
+  t->areas = tree_remove(t->areas, a);
+  free(a);
+}
+
+bool area_resize(struct thread* t, struct vm_area* a, void* end) {
+  end = pg_round_up(end);
+  ASSERT(end > a->start);
+
+  // The start, and so the area's place in the tree, stays the same.
+  if (end > a->end && area_overlaps(t, a->end, end)) return false;
+  a->end = end;
+  return true;
+}
+
+struct vm_area* area_find(struct thread* t, const void* addr) {
+  struct vm_area* a = floor_area(t->areas, addr);
+  return a && addr < a->end ? a : NULL;
+}
+
+struct vm_area* area_next(struct thread* t, const void* addr) {
+  struct vm_area* n = t->areas;
+  struct vm_area* best = NULL;
+
+  while (n) {
+    if (n->start >= addr) {
+      best = n;
+      n = n->left;
+    } else
+      n = n->right;
+  }
+  return best;
+}
+
+bool area_overlaps(struct thread* t, const void* start, const void* end) {
+  // The only candidate is the last area that starts before end.
+  struct vm_area* a = floor_area(t->areas, (const uint8_t*)end - 1);
+  return a && a->end > start;
+}
+
+void area_destroy(struct thread* t) {
+  tree_destroy(t->areas);
+  t->areas = NULL;
+}
@@ -0,0 +1,70 @@
+#ifndef AREA_H
+#define AREA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "filesys/off_t.h"
+#include "vm/page.h"
+
+// VM areas: page-aligned ranges of a process's address space that are
+// backed the same way (a segment of the executable, an mmap, or
+// anonymous memory: the heap, or an anonymous mmap).
+//
+// An area describes its pages without allocating anything per page:
+// SPT_get() creates a page's struct page from its area the first time
+// the page is needed. Each process keeps its areas in an AVL tree
+// ordered by start address. Areas never overlap, so the one holding
+// an address is the one with the greatest start at or below it, and
+// lookups and overlap checks take O(log n).
+//
+// Only the owning process touches its tree.
+
+struct mapping;
+struct thread;
+
+struct vm_area {
+  void* start;                // first page.
+  void* end;                  // one past the last page.
+  struct file* file;          // file the pages are read from, or NULL.
+  off_t ofs;                  // file offset of start.
+  size_t file_bytes;          // bytes read from file; the rest is zero.
+  bool writable;              // may the pages be written?
+  enum page_purpose purpose;  // FOR_FILE, FOR_MMAP or FOR_ANON.
+  struct mapping* mapping;    // mmap that made it, if any.
+
+  struct vm_area* left;   // areas below start.
+  struct vm_area* right;  // areas above start.
+  int height;             // height of this subtree.
+};
+
+// Adds an area of size bytes (rounded up to whole pages) at page
+// start to t, reading file_bytes bytes of file from ofs. Returns
+// NULL if it would overlap another area or if out of memory.
+struct vm_area* area_insert(struct thread* t, struct file* file, off_t ofs,
+                            void* start, size_t size, size_t file_bytes,
+                            bool writable, enum page_purpose purpose);
+
+// Removes and frees area a of t. Its pages are not touched.
+void area_remove(struct thread* t, struct vm_area* a);
+
+// Moves the end of area a of t to end (rounded up to a page), which
+// must be above a->start. Returns false, changing nothing, if that
+// would overlap another area. Pages past a shrunk end are not touched.
+bool area_resize(struct thread* t, struct vm_area* a, void* end);
+
+// Returns t's area holding addr, or NULL.
+struct vm_area* area_find(struct thread* t, const void* addr);
+
+// Returns t's first area that starts at or above addr, or NULL.
+// for (a = area_next(t, NULL); a; a = area_next(t, a->end)) visits
+// all of them in address order.
+struct vm_area* area_next(struct thread* t, const void* addr);
+
+// Does any area of t overlap [start, end)?
+bool area_overlaps(struct thread* t, const void* start, const void* end);
+
+// Frees all of t's areas.
+void area_destroy(struct thread* t);
+
+#endif /* vm/area.h */
@@ -6,7 +6,6 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
-#include <list.h>
 #include <round.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -17,6 +16,7 @@
 #include "devices/timer.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
@@ -25,210 +25,1382 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "vm/page.h"
+#include "vm/pcache.h"
 #include "vm/swap.h"
 
+/* Frame table: one entry per frame of the user pool. */
+static struct frame* frame_table;
+
+/* Number of entries in frame_table, and the frame backing entry 0. */
+static size_t frame_cnt;
+static uint8_t* user_pool_base;
+
+/* Lock for frame_alloc, which is critical section. */
+static struct lock frame_lock;
+
+/* Shared zero frame, from the kernel pool. */
+static void* zero_page;
+
+/* Clock hand: index of the next frame find_victim() considers. */
+static size_t clock_hand;
+
+/* Page replacement policy.
+   choose() is called with frame_lock held. It returns an in-use frame
+   that has at least one mapping, or NULL if there is no such frame. */
+struct frame_policy {
+  const char* name;
+  struct frame* (*choose)(void);
+};
+
+static struct frame* clock_choose(void);
+static struct frame* wsclock_choose(void);
+static struct frame* aging_choose(void);
+
+static const struct frame_policy policies[] = {
+    {"clock", clock_choose},
+    {"wsclock", wsclock_choose},
+    {"aging", aging_choose},
+};
+static const struct frame_policy* policy = &policies[0];
+
+/* WSClock: a frame unreferenced for more than this many timer ticks
+   has left the working set of its owner. */
+#define WSCLOCK_TAU 50
+
+/* Aging: age counters are shifted once per this many timer ticks.
+   The timer counts the periods in aging_pending (see frame_tick()) and
+   wakes kswapd, which shifts them in; without kswapd, aging_choose()
+   catches up when it runs. */
+#define AGING_PERIOD 4
+static int aging_pending;
+
+/* kswapd: woken by frame_alloc() when fewer than low_watermark user
+   frames are free, it evicts until high_watermark frames are free and
+   then writes back up to KSWAPD_CLEAN_CNT dirty frames ahead of the
+   clock hand, so that evicting them later needs no I/O. */
+#define KSWAPD_LOW_DIV 32   // low watermark: 1/32 of the frames.
+#define KSWAPD_HIGH_DIV 16  // high watermark: 1/16 of the frames.
+#define KSWAPD_CLEAN_CNT 8
+static struct semaphore kswapd_sema;
+static bool kswapd_running;
+static bool kswapd_awake;  // kswapd_sema is up. (interrupts off!)
+static size_t low_watermark, high_watermark;
+
+static void kswapd(void* aux);
+static void kswapd_wake(void);
+static void frame_clean_ahead(size_t cnt);
+
+/* A reference to an mmap file, held for a writeback. Once the write is
+   done it goes on deferred_closes (interrupts off!) to be closed. */
+struct writeback {
+  struct file* file;
+  struct list_elem elem;
+};
+static struct list deferred_closes;
+
+/* Resident-set limit, in frames, for processes that did not set their
+   own with rsslimit(). 0: no limit. */
+static size_t default_rss_limit;
+
+/* OOM killer: after marking a process to be killed, wait this many
+   timer ticks for it to exit before looking for another. */
+#define OOM_WAIT_TICKS 10
+
+/* Statistics. */
+static long long evict_cnt;       // # of frames evicted.
+static long long kswapd_evict_cnt;  // # of those evicted by kswapd.
+static long long clean_cnt;       // # of dirty frames cleaned by kswapd.
+static long long swap_write_cnt;  // # of pages written to swap.
+static long long file_write_cnt;  // # of mmap pages written back to files.
+static long long cow_share_cnt;   // # of frames shared by fork().
+static long long cow_copy_cnt;    // # of copy-on-write faults that copied.
+static long long cow_reuse_cnt;   // # of those that reused the frame.
+static long long zero_map_cnt;    // # of read faults served by zero_page.
+static long long zero_break_cnt;  // # of those later written to.
+static long long prefault_cnt;    // # of pages mapped by fault-around.
+static long long prefault_used_cnt;  // # of those accessed: faults avoided.
+static long long drop_cnt;        // # of pages dropped by madvise().
+static long long local_evict_cnt;  // # of evictions by local replacement.
+static long long oom_kill_cnt;    // # of processes killed for memory.
+
 void frame_table_init(size_t user_frame_limit) {
-  list_init(&frame_table);  // initialize list frame_table.
-  lock_init(&frame_lock);   // initialize frame lock.
+  size_t i;
+
+  // Entries are indexed by frame number, so size the table from the
+  // pool palloc actually set up rather than from the requested limit.
+  user_pool_base = palloc_user_pool(&frame_cnt);
+  ASSERT(frame_cnt <= user_frame_limit);
+
+  frame_table = calloc(frame_cnt, sizeof *frame_table);
+  if (frame_cnt > 0 && frame_table == NULL)
+    PANIC("frame_table_init: out of memory");
+  for (i = 0; i < frame_cnt; i++) {
+    frame_table[i].frame_addr = user_pool_base + i * PGSIZE;
+    list_init(&frame_table[i].mappings);
+  }
+
+  zero_page = palloc_get_page(PAL_VM | PAL_ZERO);
+  if (zero_page == NULL) PANIC("frame_table_init: no zero page");
+
+  lock_init(&frame_lock);  // initialize frame lock.
+  list_init(&deferred_closes);
+  clock_hand = 0;
+  pcache_init();
 }
 
 struct frame* find_frame(void* kpage) {
-  // frame table is empty: return NULL
-  if (list_empty(&frame_table)) return NULL;
+  uint8_t* addr = kpage;
+  struct frame* f;
+
+  // kpage is outside the user pool: no such frame.
+  if (addr < user_pool_base || addr >= user_pool_base + frame_cnt * PGSIZE)
+    return NULL;
 
+  f = &frame_table[(addr - user_pool_base) / PGSIZE];
+  return f->in_use ? f : NULL;
+}
+
+// Returns the frame table entry for KPAGE, whether in use or not.
+static struct frame* frame_entry(void* kpage) {
+  uint8_t* addr = kpage;
+  if (addr < user_pool_base || addr >= user_pool_base + frame_cnt * PGSIZE)
+    return NULL;
+  return &frame_table[(addr - user_pool_base) / PGSIZE];
+}
+
+// Adds P to the rmap of frame F, charging it to P's owner's resident
+// set. (call this with frame_lock!)
+static void rmap_add(struct frame* f, struct page* p) {
+  list_push_back(&f->mappings, &p->rmap_elem);
+  p->owner->rss++;
+}
+
+// Takes the first page off the rmap of F, which must not be empty.
+// (call this with frame_lock!)
+static struct page* rmap_pop(struct frame* f) {
+  struct page* p =
+      list_entry(list_pop_front(&f->mappings), struct page, rmap_elem);
+  p->owner->rss--;
+  return p;
+}
+
+// Takes F out of the page cache, if it is in it. Once that happens the
+// frame is private to its current mappings. (call this with frame_lock!)
+static void frame_uncache(struct frame* f) {
+  if (f->cache) {
+    pcache_remove(f->cache);
+    f->cache = NULL;
+  }
+}
+
+// Settles fault-around accounting for P, whose accessed bit is ACCESSED,
+// the first time that bit is looked at (or lost) after P was mapped.
+static void prefault_settle(struct page* p, bool accessed) {
+  if (p->is_prefaulted) {
+    p->is_prefaulted = false;
+    if (accessed) prefault_used_cnt++;
+  }
+}
+
+// Second chance test for F: true if any mapping referenced the frame
+// since the last sweep. Clears the accessed bit on every mapping.
+static bool frame_test_and_clear_accessed(struct frame* f) {
   struct list_elem* e;
-  struct frame* f;
-  // lock_acquire(&frame_lock);
+  bool accessed = false;
+
+  for (e = list_begin(&f->mappings); e != list_end(&f->mappings);
+       e = list_next(e)) {
+    struct page* p = list_entry(e, struct page, rmap_elem);
+    uint32_t* pagedir = p->owner->pagedir;
+    if (pagedir_is_accessed(pagedir, p->page_addr)) {
+      prefault_settle(p, true);
+      pagedir_set_accessed(pagedir, p->page_addr, false);
+      accessed = true;
+    }
+  }
+  return accessed;
+}
+
+// True if any mapping of F (or its kernel alias) has written to it.
+static bool frame_is_dirty(struct frame* f) {
+  struct list_elem* e;
+
+  for (e = list_begin(&f->mappings); e != list_end(&f->mappings);
+       e = list_next(e)) {
+    struct page* p = list_entry(e, struct page, rmap_elem);
+    if (pagedir_is_dirty(p->owner->pagedir, p->page_addr) ||
+        pagedir_is_dirty(p->owner->pagedir, f->frame_addr))
+      return true;
+  }
+  return false;
+}
 
-  for (e = list_begin(&frame_table); e != list_end(&frame_table);
+// Updates and returns F's is_evictable. Without a mapping nobody can
+// fault the frame back in, and stack pages are only evicted as a last
+// resort. Pinned frames are not evictable at all.
+static bool frame_check_evictable(struct frame* f) {
+  struct list_elem* e;
+
+  if (f->pin_cnt > 0) return false;
+  if (list_empty(&f->mappings)) f->is_evictable = false;
+  for (e = list_begin(&f->mappings); e != list_end(&f->mappings);
        e = list_next(e)) {
-    f = list_entry(e, struct frame, ftable_elem);
-    if (f->frame_addr == kpage) return f;
+    struct page* p = list_entry(e, struct page, rmap_elem);
+    if (p->page_addr >= pg_round_down(PHYS_BASE - 0x800000))
+      f->is_evictable = false;
   }
+  return f->is_evictable;
+}
 
-  // lock_release(&frame_lock);
+// Last resort when no evictable frame is left: any unpinned frame with
+// a mapping (i.e. a stack page), starting at the clock hand.
+static struct frame* any_mapped_frame(void) {
+  size_t i;
 
-  // No such frame is found: return NULL.
+  for (i = 0; i < frame_cnt; i++) {
+    struct frame* f = &frame_table[(clock_hand + i) % frame_cnt];
+    if (f->in_use && f->pin_cnt == 0 && !list_empty(&f->mappings)) return f;
+  }
   return NULL;
 }
 
-struct frame* find_victim() {
-  // frame table is empty: return NULL
-  if (list_empty(&frame_table)) return NULL;
-  if (!ft_cursor) ft_cursor = list_begin(&frame_table);
+// One-bit second chance clock. Two sweeps suffice: the first clears
+// every accessed bit it passes.
+static struct frame* clock_choose(void) {
+  size_t counter;
 
-  struct frame* f;
-  uint32_t* pagedir;
-  size_t loop_lim = 10000;
-  size_t counter = 0;
+  for (counter = 0; counter < 2 * frame_cnt; counter++) {
+    struct frame* f = &frame_table[clock_hand];
+    clock_hand = (clock_hand + 1) % frame_cnt;
+    if (!f->in_use || !frame_check_evictable(f)) continue;
+    if (!frame_test_and_clear_accessed(f)) return f;
+  }
+  return any_mapped_frame();
+}
 
-  struct list_elem* victim_cursor = NULL;
+// WSClock: like clock, but a frame referenced within the last
+// WSCLOCK_TAU ticks is in its working set and is skipped, and clean
+// frames are preferred over dirty ones so eviction avoids a write.
+static struct frame* wsclock_choose(void) {
+  int64_t now = timer_ticks();
+  struct frame* old_dirty = NULL;
+  struct frame* young = NULL;
+  size_t counter;
 
-  lock_acquire(&frame_lock);
+  for (counter = 0; counter < 2 * frame_cnt; counter++) {
+    struct frame* f = &frame_table[clock_hand];
+    clock_hand = (clock_hand + 1) % frame_cnt;
+    if (!f->in_use || !frame_check_evictable(f)) continue;
 
-  while (counter < loop_lim) {
-    f = list_entry(ft_cursor, struct frame, ftable_elem);
-    pagedir = f->owner_thread->pagedir;
-    struct page* p = SPT_search(f->owner_thread, f->page_addr);
-    if (!p || !f->page_addr ||
-        f->page_addr >= pg_round_down(PHYS_BASE - 0x800000)) {
-      f->is_evictable = false;
+    if (frame_test_and_clear_accessed(f)) {
+      f->last_use = now;
+    } else if (now - f->last_use <= WSCLOCK_TAU) {
+      if (!young) young = f;
+    } else if (frame_is_dirty(f)) {
+      if (!old_dirty) old_dirty = f;
+    } else {
+      return f;
     }
+  }
 
-    if (!f->is_evictable || pagedir_is_accessed(pagedir, f->page_addr)) {
-      ft_cursor = list_next(ft_cursor);
-      if (ft_cursor == list_end(&frame_table))
-        ft_cursor = list_begin(&frame_table);
-      if (f->is_evictable) pagedir_set_accessed(pagedir, f->page_addr, false);
-      counter++;
-    } else {
-      victim_cursor = ft_cursor;
-      ft_cursor = list_next(ft_cursor);
-      if (ft_cursor == list_end(&frame_table))
-        ft_cursor = list_begin(&frame_table);
-      f = list_entry(victim_cursor, struct frame, ftable_elem);
-      break;
+  if (old_dirty) return old_dirty;
+  if (young) return young;
+  return any_mapped_frame();
+}
+
+// Shifts every frame's age counter once per period the timer counted,
+// feeding in the accessed bits. kswapd runs this once per period, so
+// each shift sees one period's bit; only if it lags do several periods
+// share a bit. Not done in the timer interrupt, which cannot take
+// frame_lock. (call this with frame_lock!)
+static void aging_sample(void) {
+  enum intr_level old_level;
+  int periods;
+  size_t i;
+
+  old_level = intr_disable();
+  periods = aging_pending;
+  aging_pending = 0;
+  intr_set_level(old_level);
+  if (periods == 0) return;
+
+  for (i = 0; i < frame_cnt; i++) {
+    struct frame* f = &frame_table[i];
+    if (!f->in_use) continue;
+    f->age = periods < 8 ? f->age >> periods : 0;
+    if (frame_test_and_clear_accessed(f)) f->age |= 0x80;
+  }
+}
+
+// Aging: evict the evictable frame with the smallest age counter,
+// i.e. the one least recently used at the sampling granularity.
+static struct frame* aging_choose(void) {
+  struct frame* victim = NULL;
+  size_t i;
+
+  if (!kswapd_running) aging_sample();
+  for (i = 0; i < frame_cnt; i++) {
+    struct frame* f = &frame_table[(clock_hand + i) % frame_cnt];
+    if (!f->in_use || !frame_check_evictable(f)) continue;
+    if (!victim || f->age < victim->age) victim = f;
+    if (victim->age == 0) break;
+  }
+  if (victim) {
+    clock_hand = (victim - frame_table + 1) % frame_cnt;
+    return victim;
+  }
+  return any_mapped_frame();
+}
+
+bool frame_set_policy(const char* name) {
+  size_t i;
+
+  for (i = 0; i < sizeof policies / sizeof *policies; i++)
+    if (!strcmp(name, policies[i].name)) {
+      policy = &policies[i];
+      return true;
     }
+  return false;
+}
+
+// True if F has mappings and all of them belong to T.
+// (call this with frame_lock!)
+static bool frame_owned_by(struct frame* f, struct thread* t) {
+  struct list_elem* e;
+
+  if (list_empty(&f->mappings)) return false;
+  for (e = list_begin(&f->mappings); e != list_end(&f->mappings);
+       e = list_next(e))
+    if (list_entry(e, struct page, rmap_elem)->owner != t) return false;
+  return true;
+}
+
+// Local replacement: second chance among the evictable frames that only
+// T maps, so that T pages against itself. Frames T shares with other
+// processes are left alone. Does not move the global clock hand.
+static struct frame* local_choose(struct thread* t) {
+  size_t hand = clock_hand;
+  size_t counter;
+
+  for (counter = 0; counter < 2 * frame_cnt; counter++) {
+    struct frame* f = &frame_table[hand];
+    hand = (hand + 1) % frame_cnt;
+    if (!f->in_use || !frame_check_evictable(f) || !frame_owned_by(f, t))
+      continue;
+    if (!frame_test_and_clear_accessed(f)) return f;
   }
+  return NULL;
+}
 
-  lock_release(&frame_lock);
+// Picks a victim with CHOOSE (called with T) and takes it out of the
+// table (and the page cache) so nobody else picks it or maps it.
+static struct frame* take_victim(struct frame* (*choose)(struct thread*),
+                                 struct thread* t) {
+  struct frame* f;
+
+  // frame table is empty: return NULL
+  if (frame_cnt == 0) return NULL;
 
+  lock_acquire(&frame_lock);
+  f = choose(t);
+  if (f != NULL) {
+    f->in_use = false;
+    frame_uncache(f);
+  }
+  lock_release(&frame_lock);
   return f;
 }
 
-void swap_frame(struct frame* victim) {
-  // Assume that the victim is removed from the frame table.
-  void* page_addr = victim->page_addr;
-  void* frame_addr = victim->frame_addr;
-  struct thread* owner = victim->owner_thread;
-  struct page* page = SPT_search(owner, page_addr);
-  // printf("Evicting page %p whose frame is %p\n", page_addr, frame_addr);
-  if (!page) {
-    if (victim->is_evictable) printf("NOOOOO\n");
-    palloc_free_page(frame_addr);
-    free(victim);
-    return;
+static struct frame* policy_choose(struct thread* t UNUSED) {
+  return policy->choose();
+}
+
+struct frame* find_victim() { return take_victim(policy_choose, NULL); }
+
+// Opens a reference of our own to FILE for a writeback: its owner may
+// exit and close it during the write. (call this with frame_lock!)
+static struct writeback* writeback_open(struct file* file) {
+  struct writeback* wb = malloc(sizeof *wb);
+
+  if (wb == NULL) return NULL;
+  wb->file = file_reopen(file);
+  if (wb->file == NULL) {
+    free(wb);
+    return NULL;
   }
-  if (!is_user_vaddr(page_addr)) {
-    PANIC("Tried to evict a kernel page!");
+  return wb;
+}
+
+// Done with WB. Closing takes filesys_lock, which the eviction path
+// must never wait for (exec() holds it while the child loads), so WB
+// waits for frame_close_deferred().
+static void writeback_close(struct writeback* wb) {
+  enum intr_level old_level = intr_disable();
+
+  list_push_back(&deferred_closes, &wb->elem);
+  intr_set_level(old_level);
+  if (kswapd_running) kswapd_wake();
+}
+
+void frame_close_deferred(void) {
+  for (;;) {
+    enum intr_level old_level = intr_disable();
+    struct writeback* wb;
+
+    if (list_empty(&deferred_closes)) {
+      intr_set_level(old_level);
+      return;
+    }
+    wb = list_entry(list_pop_front(&deferred_closes), struct writeback, elem);
+    intr_set_level(old_level);
+
+    lock_acquire(&filesys_lock);
+    file_close(wb->file);
+    lock_release(&filesys_lock);
+    free(wb);
   }
+}
+
+bool swap_frame(struct frame* victim) { return swap_frames(&victim, 1) == 1; }
+
+size_t swap_frames(struct frame** victims, size_t cnt) {
+  // Assume that the victims are removed from the frame table.
+  void* pages[SD_BATCH_MAX];
+  size_t slots[SD_BATCH_MAX];
+  size_t swap_i[SD_BATCH_MAX];
+  bool need_swap[SD_BATCH_MAX];
+  struct writeback* files[SD_BATCH_MAX];  // mmap file to write back, if any.
+  off_t ofs[SD_BATCH_MAX];
+  bool keep[SD_BATCH_MAX];  // could not be written back: put it back.
+  size_t page_cnt = 0;
+  size_t freed_cnt = 0;
+  size_t i, j;
+
+  ASSERT(cnt <= SD_BATCH_MAX);
 
-  enum page_purpose pur = page->purpose;
+  // i) decide what each victim needs, under the lock: an exiting owner
+  //    may free the pages on the rmap at any time otherwise. Nothing
+  //    read here is used after it, so mmap files are reopened for the
+  //    writeback.
+  lock_acquire(&frame_lock);
+  for (i = 0; i < cnt; i++) {
+    struct frame* victim = victims[i];
+    void* frame_addr = victim->frame_addr;
+    struct list_elem* e;
+    struct page* page;
+    bool dirty;
+
+    swap_i[i] = BITMAP_ERROR;
+    need_swap[i] = false;
+    files[i] = NULL;
+    keep[i] = false;
 
-  switch (pur) {
-    case FOR_FILE:
-      if (pagedir_is_dirty(owner->pagedir, page_addr) || 
-          pagedir_is_dirty(owner->pagedir, frame_addr)) {
-        // printf("swap_i before write: %zu\n", page->swap_i);
-        uint8_t* bytes = frame_addr;
-        page->swap_i = SD_write(frame_addr);
-        page->is_swapped = true;
-        pagedir_set_dirty(owner->pagedir, page_addr, false);
+    // printf("Evicting frame %p\n", frame_addr);
+    // Its owners exited after it was chosen: just free it.
+    if (list_empty(&victim->mappings)) continue;
 
-      } else {
-        page->swap_i = BITMAP_ERROR;
-        page->is_swapped = false;
+    for (e = list_begin(&victim->mappings); e != list_end(&victim->mappings);
+         e = list_next(e)) {
+      page = list_entry(e, struct page, rmap_elem);
+      if (!is_user_vaddr(page->page_addr)) {
+        PANIC("Tried to evict a kernel page!");
       }
+    }
 
-      break;
+    // The frame is dirty if any mapping wrote to it. (The kernel alias
+    // counts as well, since the fault handler fills frames through kpage.)
+    dirty = frame_is_dirty(victim);
 
-    case FOR_STACK:
-      ASSERT(victim->is_evictable == false);
-      page->swap_i = SD_write(frame_addr);
-      page->is_swapped = true;
-      break;
+    // All mappings share the frame's contents, so write them back once.
+    // A clean frame that kswapd already copied to swap keeps that slot.
+    page = list_entry(list_front(&victim->mappings), struct page, rmap_elem);
+    if (dirty) {
+      SD_free(victim->swap_i);
+    } else {
+      swap_i[i] = victim->swap_i;
+    }
+    victim->swap_i = BITMAP_ERROR;
+
+    switch (page->purpose) {
+      case FOR_FILE:
+        // Read-only pages can be read from the file again. (Only the
+        // kernel alias could have dirtied them, when they were filled.)
+        need_swap[i] = dirty && page->is_writable;
+        break;
+
+      case FOR_STACK:
+        ASSERT(victim->is_evictable == false);
+        need_swap[i] = swap_i[i] == BITMAP_ERROR;
+        break;
+
+      case FOR_ANON:
+        // Same as the stack, but evicted like any other page.
+        need_swap[i] = swap_i[i] == BITMAP_ERROR;
+        break;
+
+      case FOR_MMAP:
+        if (dirty) {
+          files[i] = writeback_open(page->page_file);
+          ofs[i] = page->ofs;
+          keep[i] = files[i] == NULL;
+        }
+        break;
+    }
+    if (need_swap[i]) pages[page_cnt++] = frame_addr;
+  }
+  lock_release(&frame_lock);
+
+  // ii) write mmap pages back to their files, and every page that needs
+  //     swap as one clustered batch
+  for (i = 0; i < cnt; i++) {
+    if (files[i] == NULL) continue;
+    file_write_at(files[i]->file, victims[i]->frame_addr, PGSIZE, ofs[i]);
+    writeback_close(files[i]);
+    file_write_cnt++;
+  }
+  SD_write_batch(pages, page_cnt, slots);
+  swap_write_cnt += page_cnt;
+
+  // iii) then detach every mapping. (Under the lock, so that fork()
+  //      never sees a page halfway between its frame and swap.)
+  lock_acquire(&frame_lock);
+  for (i = 0, j = 0; i < cnt; i++) {
+    struct frame* victim = victims[i];
+    struct page* page;
 
-    case FOR_MMAP:
-      if (pagedir_is_dirty(owner->pagedir, page_addr)) {
-        file_write_at(page->page_file, frame_addr, PGSIZE, page->ofs);
-        pagedir_set_dirty(owner->pagedir, page_addr, false);
+    // Out of memory to reopen the file: the frame stays the only copy.
+    if (keep[i] && !list_empty(&victim->mappings)) {
+      victim->in_use = true;
+      continue;
+    }
+    if (need_swap[i]) {
+      swap_i[i] = slots[j++];
+      // Swap is full: the frame stays the only copy. Put it back, still
+      // dirty, unless every mapping went away meanwhile.
+      if (swap_i[i] == BITMAP_ERROR && !list_empty(&victim->mappings)) {
+        victim->in_use = true;
+        continue;
       }
-      page->swap_i = BITMAP_ERROR;
-      page->is_swapped = false;
-      break;
+    }
+    evict_cnt++;
+    freed_cnt++;
+    // Each mapping holds its own reference to the slot.
+    bool first = true;
+    while (!list_empty(&victim->mappings)) {
+      page = rmap_pop(victim);
+      if (!first) SD_dup(swap_i[i]);
+      first = false;
+      page->swap_i = swap_i[i];
+      page->is_swapped = swap_i[i] != BITMAP_ERROR;
+      if (page->is_swapped) page->owner->swap_cnt++;
+      page->frame_addr = NULL;
+      prefault_settle(page, pagedir_is_accessed(page->owner->pagedir,
+                                                page->page_addr));
+      pagedir_clear_page(page->owner->pagedir, page->page_addr);
+    }
+    // Every mapping went away meanwhile: nobody holds the slot.
+    if (first) SD_free(swap_i[i]);
+    palloc_free_page(victim->frame_addr);
+  }
+  lock_release(&frame_lock);
+  return freed_cnt;
+}
+
+// Sums up a process's claim on memory for the OOM killer.
+struct oom_search {
+  struct thread* victim;   // worst process so far.
+  size_t badness;          // its resident plus swapped pages.
+  struct thread* pending;  // killed already, memory not freed yet.
+};
+
+static void oom_badness(struct thread* t, void* aux) {
+  struct oom_search* s = aux;
+  size_t badness = t->rss + t->swap_cnt;
+
+  if (t->pagedir == NULL) return;
+  if (t->oom_killed) {
+    s->pending = t;
+    return;
   }
-  palloc_free_page(frame_addr);
-  page->frame_addr = NULL;
+  if (s->victim == NULL || badness > s->badness) {
+    s->victim = t;
+    s->badness = badness;
+  }
+}
+
+// Out of memory: no frame can be evicted, or swap is full. Picks the
+// process with the most resident plus swapped pages and kills it, which
+// frees its memory when it exits. The running process exits right away;
+// any other one dies before it next returns to user mode (see
+// threads/interrupt.c), or when woken if it is blocked in wait(). We
+// give it OOM_WAIT_TICKS to do that, and until it has freed its memory
+// later calls wait for it too rather than kill someone else.
+static void oom_kill(void) {
+  struct oom_search s = {NULL, 0, NULL};
+  struct thread* cur = thread_current();
+  enum intr_level old_level;
+  char name[sizeof cur->name];
+  size_t rss = 0, swap_cnt = 0;
+
+  // The victim may exit as soon as interrupts are on again: copy what
+  // is printed about it first.
+  old_level = intr_disable();
+  thread_foreach(oom_badness, &s);
+  if (s.pending == NULL && s.victim != NULL) {
+    s.victim->oom_killed = true;
+    if (s.victim->waiting_for != NULL) {
+      sema_up(&s.victim->waiting_for->child_sema);
+      s.victim->waiting_for = NULL;
+      s.victim->wait_interrupted = true;
+    }
+    strlcpy(name, s.victim->name, sizeof name);
+    rss = s.victim->rss;
+    swap_cnt = s.victim->swap_cnt;
+  }
+  intr_set_level(old_level);
 
-  pagedir_clear_page(owner->pagedir, page_addr);
-  free(victim);
+  if (s.pending != NULL) {
+    if (s.pending != cur) {
+      timer_sleep(OOM_WAIT_TICKS);
+      return;
+    }
+    s.victim = cur;
+  } else {
+    if (s.victim == NULL) PANIC("frame_alloc: out of memory");
+    oom_kill_cnt++;
+    printf("Out of memory: killing %s (%zu resident, %zu swapped pages)\n",
+           name, rss, swap_cnt);
+  }
+
+  if (s.victim == cur) {
+    if (lock_held_by_current_thread(&filesys_lock))
+      lock_release(&filesys_lock);
+    exit(-1);
+  }
+  timer_sleep(OOM_WAIT_TICKS);
 }
 
 void* frame_alloc(enum palloc_flags flags, bool is_evictable) {
-  // i) create new struct frame
-  struct frame* new_frame = malloc(sizeof(struct frame));
+  struct frame* new_frame;
   struct frame* victim = NULL;
 
-  // ii) assign palloc's result to member void* frame_addr
-  uint8_t* kpage = palloc_get_page(flags);
+  ASSERT(flags & PAL_USER);
+
+  // i) a process at its resident-set limit replaces one of its own
+  //    pages first (local replacement)
+  if (frame_rss_full()) {
+    victim = take_victim(local_choose, thread_current());
+    if (victim && swap_frame(victim)) local_evict_cnt++;
+  }
+
+  // ii) get a frame from the user pool
+  uint8_t* kpage = palloc_get_page(flags | PAL_VM);
   while (!kpage) {
     // have to use page replacement algorithm
     victim = find_victim();
-    lock_acquire(&frame_lock);
-    list_remove(&(victim->ftable_elem));
-    lock_release(&frame_lock);
-    swap_frame(victim);
-    kpage = palloc_get_page(flags);
+    if (!victim || !swap_frame(victim)) oom_kill();
+    kpage = palloc_get_page(flags | PAL_VM);
   }
-  new_frame->is_evictable = is_evictable;
-  new_frame->frame_addr = kpage;
-  new_frame->page_addr = NULL;
-
-  // iii) assign current thread to member owner_thread
-  new_frame->owner_thread = thread_current();
 
-  // iv) record access time (redundant for second chance)
-  // new_frame->access_time = timer_ticks();
+  // Let kswapd refill the free pool before the next fault runs dry.
+  if (kswapd_running && palloc_user_free_cnt() < low_watermark)
+    kswapd_wake();
 
-  // v) push struct into static struct list frame_table.
-  //    since this is the critical section, use lock!
+  // iii) fill in its preallocated frame table entry.
+  //     since this is the critical section, use lock!
   lock_acquire(&frame_lock);
-  list_push_back(&frame_table, &new_frame->ftable_elem);
-  if (!ft_cursor) ft_cursor = list_begin(&frame_table);
+  new_frame = &frame_table[(kpage - user_pool_base) / PGSIZE];
+  ASSERT(!new_frame->in_use);
+  new_frame->is_evictable = is_evictable;
+
+  //      mappings are added by frame_map() once the SPT entry exists
+  list_init(&new_frame->mappings);
+  new_frame->age = 0x80;
+  new_frame->last_use = timer_ticks();
+  new_frame->swap_i = BITMAP_ERROR;
+  new_frame->cache = NULL;
+  new_frame->pin_cnt = 0;
+  new_frame->in_use = true;
   lock_release(&frame_lock);
 
-  // vi) return kernel virtual address (physical address)
+  // iv) return kernel virtual address (physical address)
   return kpage;
 }
 
-void frame_update_upage(void* upage, void* kpage) {
+void frame_map(void* kpage, struct page* p) {
   // Reading frame table has potential race condition,
   // so we use lock here again!
   lock_acquire(&frame_lock);
   struct frame* f = find_frame(kpage);
-  if (f) f->page_addr = upage;
+  if (f) {
+    rmap_add(f, p);
+    f->is_evictable = true;
+  }
+  lock_release(&frame_lock);
+}
+
+// Removes P from the rmap of frame F. Returns true if it was there.
+// (call this with frame_lock!)
+static bool rmap_remove(struct frame* f, struct page* p) {
+  struct list_elem* e;
+
+  for (e = list_begin(&f->mappings); e != list_end(&f->mappings);
+       e = list_next(e)) {
+    if (e == &p->rmap_elem) {
+      list_remove(e);
+      p->owner->rss--;
+      return true;
+    }
+  }
+  return false;
+}
+
+// True if P is in the rmap of frame F. (call this with frame_lock!)
+static bool rmap_contains(struct frame* f, struct page* p) {
+  struct list_elem* e;
+
+  for (e = list_begin(&f->mappings); e != list_end(&f->mappings);
+       e = list_next(e))
+    if (e == &p->rmap_elem) return true;
+  return false;
+}
+
+void frame_unmap(struct page* p) {
+  struct frame* f;
+
+  if (!p->frame_addr) return;
+
+  lock_acquire(&frame_lock);
+  f = frame_entry(p->frame_addr);
+  if (f) rmap_remove(f, p);
+  lock_release(&frame_lock);
+}
+
+void frame_release(struct page* p) {
+  struct frame* f;
+
+  if (!p->frame_addr) return;
+  prefault_settle(p, pagedir_is_accessed(p->owner->pagedir, p->page_addr));
+
+  lock_acquire(&frame_lock);
+  f = frame_entry(p->frame_addr);
+  if (f && rmap_remove(f, p) && f->in_use && list_empty(&f->mappings)) {
+    frame_free(p->frame_addr);  // releases frame_lock.
+    return;
+  }
+  lock_release(&frame_lock);
+}
+
+// frame_release_all() collects what it frees and hands it back in
+// batches: runs of adjacent frames, and up to SD_BATCH_MAX swap slots.
+struct teardown {
+  uint8_t* run;        // first frame of the current run of free frames.
+  size_t run_cnt;      // frames in it.
+  size_t slots[SD_BATCH_MAX];
+  size_t slot_cnt;
+};
+
+static void teardown_free_frame(struct teardown* td, struct frame* f) {
+  uint8_t* kpage = f->frame_addr;
+
+  if (td->run_cnt > 0 && kpage == td->run + td->run_cnt * PGSIZE) {
+    td->run_cnt++;
+    return;
+  }
+  palloc_free_multiple(td->run, td->run_cnt);
+  td->run = kpage;
+  td->run_cnt = 1;
+}
+
+static void teardown_free_slot(struct teardown* td, size_t slot) {
+  if (slot == BITMAP_ERROR) return;
+  td->slots[td->slot_cnt++] = slot;
+  if (td->slot_cnt == SD_BATCH_MAX) {
+    SD_free_batch(td->slots, td->slot_cnt);
+    td->slot_cnt = 0;
+  }
+}
+
+void frame_release_all(struct thread* t) {
+  struct teardown td = {NULL, 0, {0}, 0};
+  struct ohash_iterator it;
+
+  lock_acquire(&frame_lock);
+  ohash_first(&it, &t->SPT);
+  while (ohash_next(&it)) {
+    struct page* p = ohash_entry(ohash_cur(&it), struct page, SPT_elem);
+    struct frame* f;
+
+    if (p->is_swapped) {
+      teardown_free_slot(&td, p->swap_i);
+      p->swap_i = BITMAP_ERROR;
+      p->is_swapped = false;
+      t->swap_cnt--;
+      continue;
+    }
+    if (!p->frame_addr) continue;
+
+    // The PTE stays: the page directory goes right after, so there is
+    // no point in clearing it or flushing it from the TLB.
+    prefault_settle(p, pagedir_is_accessed(t->pagedir, p->page_addr));
+    f = frame_entry(p->frame_addr);
+    // T was killed (by the OOM killer) in the middle of a system call.
+    if (f && p->is_pinned) f->pin_cnt--;
+    p->is_pinned = false;
+    if (f && rmap_remove(f, p) && f->in_use && list_empty(&f->mappings)) {
+      f->in_use = false;
+      frame_uncache(f);
+      teardown_free_slot(&td, f->swap_i);
+      f->swap_i = BITMAP_ERROR;
+      teardown_free_frame(&td, f);
+    }
+    p->frame_addr = NULL;
+  }
+  palloc_free_multiple(td.run, td.run_cnt);
+  SD_free_batch(td.slots, td.slot_cnt);
+  lock_release(&frame_lock);
+}
+
+void* frame_get_shared(struct page* p) {
+  struct pcache_entry* e;
+  struct frame* f;
+  void* kpage = NULL;
+
+  lock_acquire(&frame_lock);
+  e = pcache_lookup(file_get_inode(p->page_file), p->ofs, p->read_bytes);
+  if (e) {
+    f = find_frame(e->kpage);
+    ASSERT(f && f->cache == e);
+    rmap_add(f, p);
+    f->is_evictable = true;
+    kpage = e->kpage;
+  }
+  lock_release(&frame_lock);
+  return kpage;
+}
+
+void frame_share(void* kpage, struct page* p) {
+  struct frame* f;
+
+  lock_acquire(&frame_lock);
+  f = find_frame(kpage);
+  // Unless it is being evicted already. pcache_insert() keeps the frame
+  // private if another process cached the same page meanwhile.
+  if (f && !f->cache)
+    f->cache =
+        pcache_insert(file_get_inode(p->page_file), p->ofs, p->read_bytes,
+                      kpage);
   lock_release(&frame_lock);
 }
 
 void frame_free(void* kpage) {
   if (!kpage) return;
-  struct list_elem* e;
   struct frame* f;
 
   if (!lock_held_by_current_thread(&frame_lock))
     lock_acquire(&frame_lock);
 
-  if (list_empty(&frame_table)) {
+  f = find_frame(kpage);
+  if (f) {
+    // update frame table
+    f->in_use = false;
+    frame_uncache(f);
+    while (!list_empty(&f->mappings)) rmap_pop(f);
+    SD_free(f->swap_i);
+    f->swap_i = BITMAP_ERROR;
+
+    // allocated by palloc_get_page(PAL_USER)
+    palloc_free_page(f->frame_addr);
+  }
+  lock_release(&frame_lock);
+}
+
+bool frame_fork_page(struct page* parent, struct page* child) {
+  struct frame* f;
+  bool ok = true;
+
+  ASSERT(child->owner == thread_current());
+
+  for (;;) {
+    lock_acquire(&frame_lock);
+    if (parent->is_swapped) {
+      // Each page holds its own reference to the slot.
+      SD_dup(parent->swap_i);
+      child->swap_i = parent->swap_i;
+      child->is_swapped = true;
+      child->owner->swap_cnt++;
+      break;
+    }
+
+    // Not loaded yet: the child loads it on its own first fault.
+    f = parent->frame_addr ? frame_entry(parent->frame_addr) : NULL;
+    if (!f || !rmap_contains(f, parent)) break;
+
+    // Being evicted or cleaned: wait until it settles.
+    if (!f->in_use) {
+      lock_release(&frame_lock);
+      thread_yield();
+      continue;
+    }
+
+    // Share the frame, read-only on both sides. A write by either
+    // side faults into frame_break_cow().
+    ok = pagedir_set_page(child->owner->pagedir, child->page_addr,
+                          f->frame_addr, false);
+    if (ok) {
+      if (parent->is_writable) {
+        parent->is_cow = child->is_cow = true;
+        pagedir_set_writable(parent->owner->pagedir, parent->page_addr,
+                             false);
+      }
+      rmap_add(f, child);
+      child->frame_addr = f->frame_addr;
+      cow_share_cnt++;
+    }
+    break;
+  }
+  lock_release(&frame_lock);
+  return ok;
+}
+
+// If P is the last mapping of its frame, takes the frame over: P is no
+// longer copy-on-write. Returns P's frame, or NULL if it is not in use
+// (being evicted). (call this with frame_lock!)
+static struct frame* cow_reuse(struct page* p) {
+  struct frame* f = p->is_swapped ? NULL : find_frame(p->frame_addr);
+
+  if (f && list_size(&f->mappings) == 1) {
+    p->is_cow = false;
+    pagedir_set_writable(p->owner->pagedir, p->page_addr, true);
+    cow_reuse_cnt++;
+  }
+  return f;
+}
+
+void frame_break_cow(struct page* p) {
+  struct frame* f;
+  struct frame* copy;
+  void* kpage;
+
+  ASSERT(p->is_cow);
+
+  lock_acquire(&frame_lock);
+  f = cow_reuse(p);
+  lock_release(&frame_lock);
+  if (!f || !p->is_cow) goto retry;
+
+  // Allocate first, without the lock: it may have to evict.
+  kpage = frame_alloc(PAL_USER, true);
+
+  lock_acquire(&frame_lock);
+  f = cow_reuse(p);
+  if (!f || !p->is_cow) {
+    frame_free(kpage);  // releases frame_lock.
+    goto retry;
+  }
+  memcpy(kpage, f->frame_addr, PGSIZE);
+  rmap_remove(f, p);
+  copy = find_frame(kpage);
+  rmap_add(copy, p);
+  copy->is_evictable = true;
+
+  p->frame_addr = kpage;
+  p->is_cow = false;
+  pagedir_clear_page(p->owner->pagedir, p->page_addr);
+  pagedir_set_page(p->owner->pagedir, p->page_addr, kpage, true);
+  cow_copy_cnt++;
+  lock_release(&frame_lock);
+  return;
+
+retry:
+  // The frame was being evicted: returning retries the access, which
+  // faults it back in once eviction is done.
+  if (!f) thread_yield();
+}
+
+bool frame_is_zero(const void* kpage) {
+  return kpage != NULL && kpage == zero_page;
+}
+
+void frame_map_zero(struct page* p) {
+  ASSERT(p->frame_addr == NULL && !p->is_swapped);
+
+  p->frame_addr = zero_page;
+  if (!pagedir_set_page(p->owner->pagedir, p->page_addr, zero_page, false))
+    printf("Failed!: pagedir_set_page in thread: %s\n", thread_name());
+  zero_map_cnt++;
+}
+
+void frame_break_zero(struct page* p) {
+  uint8_t* kpage;
+
+  ASSERT(frame_is_zero(p->frame_addr) && p->is_writable);
+
+  // Map the new frame before frame_map() makes it a victim candidate.
+  kpage = frame_alloc(PAL_USER | PAL_ZERO, p->purpose != FOR_STACK);
+  p->frame_addr = kpage;
+  pagedir_clear_page(p->owner->pagedir, p->page_addr);
+  if (!pagedir_set_page(p->owner->pagedir, p->page_addr, kpage, true))
+    printf("Failed!: pagedir_set_page in thread: %s\n", thread_name());
+  frame_map(kpage, p);
+  zero_break_cnt++;
+}
+
+bool frame_pool_low(void) {
+  return palloc_user_free_cnt() < frame_cnt / KSWAPD_HIGH_DIV ||
+         frame_rss_full();
+}
+
+void frame_set_rss_limit(size_t pages) { default_rss_limit = pages; }
+
+bool frame_rss_full(void) {
+  struct thread* cur = thread_current();
+  size_t limit = cur->rss_limit != 0 ? cur->rss_limit : default_rss_limit;
+  return limit != 0 && cur->rss >= limit;
+}
+
+void frame_swap_in(struct page* p, void* kpage) {
+  ASSERT(p->is_swapped);
+
+  SD_read(p->swap_i, kpage);
+  lock_acquire(&frame_lock);
+  p->is_swapped = false;
+  p->swap_i = BITMAP_ERROR;
+  p->owner->swap_cnt--;
+  lock_release(&frame_lock);
+}
+
+void frame_mark_prefaulted(struct page* p) {
+  p->is_prefaulted = true;
+  prefault_cnt++;
+}
+
+// Returns the frame P is mapped to, waiting out an eviction or
+// writeback in progress. NULL if P is not resident. Returns with
+// frame_lock held either way.
+static struct frame* frame_settled(struct page* p) {
+  struct frame* f;
+
+  for (;;) {
+    lock_acquire(&frame_lock);
+    f = !p->is_swapped && p->frame_addr ? frame_entry(p->frame_addr) : NULL;
+    if (!f || !rmap_contains(f, p)) return NULL;
+    if (f->in_use) return f;
+    lock_release(&frame_lock);
+    thread_yield();
+  }
+}
+
+void frame_sync(struct page* p) {
+  struct frame* f;
+  struct list_elem* e;
+  struct writeback* wb;
+  off_t ofs = p->ofs;
+
+  ASSERT(p->purpose == FOR_MMAP);
+
+  f = frame_settled(p);
+  if (!f || !frame_is_dirty(f)) {
     lock_release(&frame_lock);
     return;
   }
 
-  for (e = list_begin(&frame_table); e != list_end(&frame_table);
+  // Same protocol as frame_clean_ahead(): write through a reference of
+  // our own (left dirty if we cannot get one), clear the dirty bits,
+  // then write with the frame out of the table so nobody evicts or
+  // frees it.
+  wb = writeback_open(p->page_file);
+  if (wb == NULL) {
+    lock_release(&frame_lock);
+    return;
+  }
+  for (e = list_begin(&f->mappings); e != list_end(&f->mappings);
        e = list_next(e)) {
-    f = list_entry(e, struct frame, ftable_elem);
-    if (f->frame_addr == kpage) {
-      // update frame table
-      list_remove(e);
+    struct page* m = list_entry(e, struct page, rmap_elem);
+    pagedir_set_dirty(m->owner->pagedir, m->page_addr, false);
+    pagedir_set_dirty(m->owner->pagedir, f->frame_addr, false);
+  }
+  f->in_use = false;
+  lock_release(&frame_lock);
+
+  file_write_at(wb->file, f->frame_addr, PGSIZE, ofs);
+  writeback_close(wb);
+  file_write_cnt++;
+
+  lock_acquire(&frame_lock);
+  if (list_empty(&f->mappings))
+    palloc_free_page(f->frame_addr);
+  else
+    f->in_use = true;
+  lock_release(&frame_lock);
+}
+
+void frame_drop(struct page* p) {
+  struct frame* f;
+
+  if (p->purpose == FOR_MMAP) frame_sync(p);
+
+  if (frame_is_zero(p->frame_addr)) {
+    pagedir_clear_page(p->owner->pagedir, p->page_addr);
+    p->frame_addr = NULL;
+    return;
+  }
+
+  f = frame_settled(p);
+  if (p->is_swapped) {
+    SD_free(p->swap_i);
+    p->swap_i = BITMAP_ERROR;
+    p->is_swapped = false;
+    p->owner->swap_cnt--;
+  } else if (f) {
+    prefault_settle(p, pagedir_is_accessed(p->owner->pagedir, p->page_addr));
+    pagedir_clear_page(p->owner->pagedir, p->page_addr);
+    rmap_remove(f, p);
+    p->frame_addr = NULL;
+    p->is_cow = false;
+    drop_cnt++;
+    if (list_empty(&f->mappings)) {
+      frame_free(f->frame_addr);  // releases frame_lock.
+      return;
+    }
+  }
+  lock_release(&frame_lock);
+}
+
+void frame_tick(int64_t ticks) {
+  if (policy->choose != aging_choose || ticks % AGING_PERIOD != 0) return;
+  aging_pending++;
+  if (kswapd_running) kswapd_wake();
+}
+
+void frame_kswapd_start(void) {
+  low_watermark = frame_cnt / KSWAPD_LOW_DIV;
+  high_watermark = frame_cnt / KSWAPD_HIGH_DIV;
+  if (high_watermark <= low_watermark) return;
+
+  sema_init(&kswapd_sema, 0);
+  if (thread_create("kswapd", PRI_DEFAULT, kswapd, NULL) != TID_ERROR)
+    kswapd_running = true;
+}
+
+// Wakes kswapd, unless it is awake already. Also called from the
+// timer interrupt.
+static void kswapd_wake(void) {
+  enum intr_level old_level = intr_disable();
+
+  if (!kswapd_awake) {
+    kswapd_awake = true;
+    sema_up(&kswapd_sema);
+  }
+  intr_set_level(old_level);
+}
+
+// Body of the kswapd thread.
+static void kswapd(void* aux UNUSED) {
+  enum intr_level old_level;
+
+  for (;;) {
+    sema_down(&kswapd_sema);
+    // From here on, a wakeup means one more pass.
+    old_level = intr_disable();
+    kswapd_awake = false;
+    intr_set_level(old_level);
+
+    if (policy->choose == aging_choose) {
+      lock_acquire(&frame_lock);
+      aging_sample();
+      lock_release(&frame_lock);
+    }
+
+    frame_close_deferred();
+
+    // Woken only to sample or to close files: nothing to reclaim.
+    if (palloc_user_free_cnt() >= low_watermark) continue;
+
+    for (;;) {
+      struct frame* victims[SD_BATCH_MAX];
+      size_t free_cnt = palloc_user_free_cnt();
+      size_t cnt = 0;
+
+      if (free_cnt >= high_watermark) break;
+      while (cnt < SD_BATCH_MAX && free_cnt + cnt < high_watermark) {
+        struct frame* victim = find_victim();
+        if (!victim) break;
+        victims[cnt++] = victim;
+      }
+      if (cnt == 0) break;
+      // Nothing freed means swap is full: leave the rest to frame_alloc().
+      cnt = swap_frames(victims, cnt);
+      if (cnt == 0) break;
+      kswapd_evict_cnt += cnt;
+    }
+    frame_clean_ahead(KSWAPD_CLEAN_CNT);
+    frame_close_deferred();
+  }
+}
+
+// Writes back up to CNT dirty, evictable frames that the clock hand
+// is about to reach. The dirty bits are cleared before the write, so a
+// store that races with it just makes the frame dirty again.
+static void frame_clean_ahead(size_t cnt) {
+  struct frame* frames[SD_BATCH_MAX];
+  struct writeback* files[SD_BATCH_MAX];  // mmap file, or NULL: swap.
+  off_t ofs[SD_BATCH_MAX];
+  void* pages[SD_BATCH_MAX];
+  size_t slots[SD_BATCH_MAX];
+  size_t frame_n = 0, page_n = 0;
+  size_t i, j;
+
+  ASSERT(cnt <= SD_BATCH_MAX);
+
+  // i) pick the frames, under the lock
+  lock_acquire(&frame_lock);
+  for (i = 0; i < frame_cnt && frame_n < cnt; i++) {
+    struct frame* f = &frame_table[(clock_hand + i) % frame_cnt];
+    struct page* page;
+    struct list_elem* e;
+
+    // Cached frames hold read-only file contents: nothing to write.
+    if (!f->in_use || f->cache || !frame_check_evictable(f) ||
+        !frame_is_dirty(f))
+      continue;
+
+    // Nor do other read-only pages, which swap_frames() reads back from
+    // their files: only the fill through the kernel alias dirtied them.
+    page = list_entry(list_front(&f->mappings), struct page, rmap_elem);
+    if (!page->is_writable) continue;
+
+    files[frame_n] = NULL;
+    if (page->purpose == FOR_MMAP) {
+      files[frame_n] = writeback_open(page->page_file);
+      if (files[frame_n] == NULL) continue;
+    }
+    ofs[frame_n] = page->ofs;
+
+    for (e = list_begin(&f->mappings); e != list_end(&f->mappings);
+         e = list_next(e)) {
+      page = list_entry(e, struct page, rmap_elem);
+      pagedir_set_dirty(page->owner->pagedir, page->page_addr, false);
+      pagedir_set_dirty(page->owner->pagedir, f->frame_addr, false);
+    }
+
+    // Keep find_victim() and frame_free() away while writing; the
+    // mappings stay in place, so the owners keep running.
+    f->in_use = false;
+    SD_free(f->swap_i);
+    f->swap_i = BITMAP_ERROR;
+    frames[frame_n++] = f;
+  }
+  lock_release(&frame_lock);
 
-      // allocated by palloc_get_page(PAL_USER)
+  // ii) write them back: mmap pages to their files, the rest to swap
+  //     as one clustered batch. (Their mappings may go away meanwhile,
+  //     so only what was recorded above is used.)
+  for (i = 0; i < frame_n; i++) {
+    if (files[i]) {
+      file_write_at(files[i]->file, frames[i]->frame_addr, PGSIZE, ofs[i]);
+      writeback_close(files[i]);
+      file_write_cnt++;
+    } else {
+      pages[page_n++] = frames[i]->frame_addr;
+    }
+  }
+  SD_write_batch(pages, page_n, slots);
+  swap_write_cnt += page_n;
+  clean_cnt += frame_n;
+
+  // iii) put the frames back
+  lock_acquire(&frame_lock);
+  for (i = 0, j = 0; i < frame_n; i++) {
+    struct frame* f = frames[i];
+    bool to_swap = files[i] == NULL;
+    size_t swap_i = to_swap ? slots[j++] : BITMAP_ERROR;
+
+    if (list_empty(&f->mappings)) {
+      // Every mapping went away meanwhile: the frame is ours to free.
+      SD_free(swap_i);
       palloc_free_page(f->frame_addr);
+    } else {
+      // Swap is full: the frame is still the only copy, so dirty it
+      // again (through its kernel alias) for swap_frame() to notice.
+      if (to_swap && swap_i == BITMAP_ERROR) {
+        struct page* page =
+            list_entry(list_front(&f->mappings), struct page, rmap_elem);
+        pagedir_set_dirty(page->owner->pagedir, f->frame_addr, true);
+      }
+      f->swap_i = swap_i;
+      f->in_use = true;
+    }
+  }
+  lock_release(&frame_lock);
+}
 
-      // allocated by malloc(sizeof(struct frame))
-      free(f);
+bool frame_pin(void* upage, bool write) {
+  struct thread* t = thread_current();
+  struct page* p;
+  struct frame* f;
+  bool pinned = false;
 
-      break;
+  lock_acquire(&frame_lock);
+  p = SPT_search(t, pg_round_down(upage));
+  // Not present (or on its way out): the caller faults it in first.
+  if (p == NULL || p->frame_addr == NULL ||
+      pagedir_get_page(t->pagedir, p->page_addr) != p->frame_addr)
+    goto done;
+
+  if (p->is_pinned) {
+    pinned = true;
+  } else if (frame_is_zero(p->frame_addr)) {
+    // The zero frame is never evicted, but a write must break it first.
+    pinned = !write;
+  } else if (!write || (p->is_writable && !p->is_cow)) {
+    // A frame out of the table is being evicted or cleaned ahead; the
+    // caller tries again once that is over.
+    f = find_frame(p->frame_addr);
+    if (f != NULL) {
+      f->pin_cnt++;
+      p->is_pinned = pinned = true;
     }
   }
+done:
   lock_release(&frame_lock);
+  return pinned;
+}
+
+void frame_unpin(void* upage) {
+  struct page* p;
+  struct frame* f;
+
+  lock_acquire(&frame_lock);
+  p = SPT_search(thread_current(), pg_round_down(upage));
+  if (p != NULL && p->is_pinned) {
+    f = frame_entry(p->frame_addr);
+    ASSERT(f != NULL && f->pin_cnt > 0);
+    f->pin_cnt--;
+    p->is_pinned = false;
+  }
+  lock_release(&frame_lock);
+}
+
+void frame_print_stats(void) {
+  printf("Frames: %s policy, %lld evictions (%lld by kswapd), "
+         "%lld swap writes, %lld file writebacks, %lld cleaned ahead\n",
+         policy->name, evict_cnt, kswapd_evict_cnt, swap_write_cnt,
+         file_write_cnt, clean_cnt);
+  printf("Frames: %lld shared by fork, %lld copy-on-write copies, "
+         "%lld reused\n",
+         cow_share_cnt, cow_copy_cnt, cow_reuse_cnt);
+  printf("Frames: %lld read faults mapped the zero page, %lld later "
+         "written\n",
+         zero_map_cnt, zero_break_cnt);
+  printf("Frames: fault-around mapped %lld pages, %lld used "
+         "(faults avoided)\n",
+         prefault_cnt, prefault_used_cnt);
+  printf("Frames: %lld pages dropped by madvise\n", drop_cnt);
+  printf("Frames: %lld local replacements, %lld processes killed for "
+         "memory\n",
+         local_evict_cnt, oom_kill_cnt);
+  pcache_print_stats();
 }
@@ -2,6 +2,7 @@
 #define FRAME_H
 
 #include <list.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -19,44 +20,156 @@
 //      a) Whether each frame is free or allocated
 //      b) If it is allocated, to which page of which process(es)
 
+//    The frame table is an array with one preallocated entry per frame
+//    of the user pool, indexed by (kpage - user pool base) / PGSIZE, so
+//    looking up, allocating and freeing an entry never searches or mallocs.
+
+//    Each frame also keeps a reverse map (rmap): the list of SPT entries
+//    (struct page, via rmap_elem) that map it.  A page records its owner
+//    and upage, so eviction can reach every (pagedir, upage) mapping a
+//    frame has without an SPT lookup, and one frame may have several.
+
+struct page;
+struct pcache_entry;
+struct thread;
+
 /* Default implementation for frame. (without swap or evict, etc.) */
 struct frame {
   void* frame_addr;              // allocated frame's address. (=kpage)
-  void* page_addr;               // virtual address pointing to page. (=upage)
-  struct thread* owner_thread;   // Process(thread) who owns this frame
-  struct list_elem ftable_elem;  // list element for frame table list
+  struct list mappings;          // rmap: struct pages mapping this frame.
+  bool in_use;                   // true iff handed out by frame_alloc.
   bool is_evictable;             // true iff the corresponding SPT exists.
+  uint8_t age;                   // aging policy: shifted reference bits.
+  int64_t last_use;              // WSClock policy: tick of last reference.
+  size_t swap_i;                 // swap slot holding a clean copy, if any.
+  unsigned pin_cnt;              // # of pinned pages mapping it (see below).
+  struct pcache_entry* cache;    // page cache entry, if shared read-only.
 };
 
-/* Frame table that keeps track of all available frames. */
-static struct list frame_table;
-
-/* Lock for frame_alloc, which is critical section. */
-static struct lock frame_lock;
-
-/* Cursor to imitate circular list behavior. */
-static struct list_elem* ft_cursor = NULL;
-
-// Initialize list object named frame_table
+// Initialize the frame table, one entry per frame of the user pool.
 void frame_table_init(size_t user_frame_limit);
 
 // Find frame with physical address. (call this with frame_lock!)
 struct frame* find_frame(void* kpage);
 
-// Returns victim frame via second chance algorithm.
+// Start kswapd, which evicts in the background once free frames fall
+// below a low watermark. Call this once the swap disk is ready.
+void frame_kswapd_start(void);
+
+// Called by the timer interrupt on every tick, to drive the aging
+// policy's sampling.
+void frame_tick(int64_t ticks);
+
+// Close the files that evictions reopened for writing pages back.
+// Call this holding no locks: it takes filesys_lock.
+void frame_close_deferred(void);
+
+// Select the page replacement policy by NAME: "clock" (default),
+// "wsclock" or "aging". Returns false if there is no such policy.
+bool frame_set_policy(const char* name);
+
+// Returns victim frame chosen by the replacement policy.
 struct frame* find_victim();
 
 // Swap the frame's content with the swap disk
 // & update corresponding SPT's swap_i value.
-void swap_frame(struct frame* victim);
+// Returns false if swap is full: the frame is put back, still mapped.
+bool swap_frame(struct frame* victim);
+
+// Same as swap_frame() for CNT (at most SD_BATCH_MAX) victims at once;
+// the pages that go to swap are written as one clustered batch.
+// Returns the number of victims actually freed.
+size_t swap_frames(struct frame** victims, size_t cnt);
 
 // Allocate frame & update frame table.
+// A process at its resident-set limit evicts one of its own frames
+// first. When nothing can be evicted, the OOM killer kills the process
+// using the most memory (which may be the caller).
 void* frame_alloc(enum palloc_flags, bool);
 
-// Set upage of corresponding struct frame.
-void frame_update_upage(void* upage, void* kpage);
+// Add page P to the rmap of frame KPAGE, making the frame evictable.
+void frame_map(void* kpage, struct page* p);
+
+// Remove page P from the rmap of the frame it maps, if any.
+void frame_unmap(struct page* p);
+
+// Same as frame_unmap(), then free the frame if P was its last mapping.
+void frame_release(struct page* p);
+
+// Exit teardown: frame_release() every page of T's SPT, and free the
+// swap slots of its swapped pages, in one pass under one lock. PTEs are
+// left as they are, so T's page directory must be destroyed next with
+// pagedir_destroy_tables().
+void frame_release_all(struct thread* t);
+
+// Read-only file pages are shared through the page cache (vm/pcache.h).
+// frame_get_shared() maps P to the cached frame holding its contents
+// and returns it, or returns NULL on a miss. After a miss, the caller
+// allocates and fills a frame as usual and calls frame_share() to offer
+// it to the cache.
+void* frame_get_shared(struct page* p);
+void frame_share(void* kpage, struct page* p);
 
 // Free frame with corresponding physical address.
 void frame_free(void* kpage);
 
+// fork(): make CHILD, a fresh SPT entry of the running (child) process,
+// a copy of PARENT. A resident frame is shared by both, copy-on-write
+// if the page is writable, and a swapped page shares its swap slot.
+// Returns false if CHILD could not be mapped.
+bool frame_fork_page(struct page* parent, struct page* child);
+
+// Handle a write to P, a present copy-on-write page: give P a private
+// copy of its frame (or the frame itself, if P is its last mapping) and
+// make it writable.
+void frame_break_cow(struct page* p);
+
+// Demand-zero pages (stack, bss) that are read before they are written
+// map one shared, read-only zero frame. It is not in the frame table,
+// so it is never evicted or freed. frame_map_zero() maps P to it;
+// frame_break_zero() handles the first write to P, giving it a private
+// zeroed frame.
+void frame_map_zero(struct page* p);
+void frame_break_zero(struct page* p);
+bool frame_is_zero(const void* kpage);
+
+// True if free frames are scarce enough that filling one speculatively
+// (fault-around) is not worth it.
+bool frame_pool_low(void);
+
+// Resident-set limits. Each process's rss counts the frames it maps.
+// frame_set_rss_limit() sets the limit for processes that did not set
+// their own (0: none); frame_rss_full() tells whether the running
+// process has reached its limit.
+void frame_set_rss_limit(size_t pages);
+bool frame_rss_full(void);
+
+// Read P, a swapped page, back from swap into its new frame KPAGE.
+void frame_swap_in(struct page* p, void* kpage);
+
+// Fault-around mapped P ahead of any access. Whether P is accessed
+// before it is unmapped is counted as a fault avoided (or wasted).
+void frame_mark_prefaulted(struct page* p);
+
+// msync(): if P, a FOR_MMAP page, is resident and dirty, write it back
+// to its file and mark it clean. P stays mapped.
+void frame_sync(struct page* p);
+
+// madvise(DONTNEED): unmap P and free its frame (if P was the last
+// mapping) or swap slot. A FOR_MMAP page is written back first; any
+// other page reads back as its initial contents on the next touch.
+void frame_drop(struct page* p);
+
+// Pinning. A frame with a pinned page is never chosen for eviction, so
+// a system call can work directly on user memory (and hold filesys_lock
+// meanwhile) without faulting. frame_pin() pins the running process's
+// page UPAGE if it is present (and writable, if WRITE) and returns
+// false otherwise; the caller faults it in and tries again.
+// frame_unpin() undoes it. Exit teardown drops any pins left behind.
+bool frame_pin(void* upage, bool write);
+void frame_unpin(void* upage);
+
+// Print eviction and writeback statistics.
+void frame_print_stats(void);
+
 #endif /* vm/frame.h */
@@ -2,15 +2,13 @@
 
 #include <list.h>
 
-struct mapping *find_mapping_addr(struct list* mmap_table, void* addr) {
-	struct list_elem *e;
-	struct mapping *m;
+#include "vm/area.h"
+
+struct mapping *find_mapping_addr(struct thread* t, void* addr) {
+	struct vm_area *a = area_find(t, addr);
 	
-	for (e = list_begin(mmap_table); e != list_end(mmap_table); e = list_next(e)) {
-		m = list_entry(e, struct mapping, elem);
-		if (m->addr <= addr && addr < m->addr + m->size)
-			return m;
-	}
+	if (a != NULL && a->purpose == FOR_MMAP)
+		return a->mapping;
 	return NULL;
 }
 
@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <list.h>
+#include <stddef.h>
 #include <stdint.h>
 
 struct mapping {
@@ -13,9 +14,18 @@ struct mapping {
     int fd;
     struct list_elem elem;
     struct list pages;
+    size_t ra_window;  // readahead: pages mapped ahead on the last fault.
+    void *ra_next;     // readahead: page a sequential fault hits next.
+    int advice;        // madvise() advice for the whole mapping.
 };
 
-struct mapping *find_mapping_addr(struct list* mmap_table, void* addr);
+// Readahead window bounds, in pages.
+#define MMAP_RA_MIN 2
+#define MMAP_RA_MAX 32
+
+struct thread;
+
+struct mapping *find_mapping_addr(struct thread* t, void* addr);
 struct mapping *find_mapping_id(struct list* mmap_table, int id);
 
 #endif  /* vm/mmap.h */
\ No newline at end of file
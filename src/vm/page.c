@@ -3,6 +3,7 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <hash.h>
+#include <ohash.h>
 #include <inttypes.h>
 #include <round.h>
 #include <stdbool.h>
@@ -22,85 +23,111 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "userprog/pagedir.h"
+#include "vm/area.h"
 #include "vm/frame.h"
+#include "vm/mmap.h"
 
-unsigned SPT_hash(const struct hash_elem *e, void *aux) {
-  struct page *p = hash_entry(e, struct page, SPT_elem);
+unsigned SPT_hash(const struct ohash_elem *e, void *aux) {
+  struct page *p = ohash_entry(e, struct page, SPT_elem);
 
   // hash_bytes conveniently returns appropriate hash with given size,
   // which is better than our previous hash function, pt_no.
   return hash_bytes(&p->page_addr, sizeof(p->page_addr));
 }
 
-bool SPT_less(const struct hash_elem *a, const struct hash_elem *b, void *aux) {
-  struct page *p_a = hash_entry(a, struct page, SPT_elem);
-  struct page *p_b = hash_entry(b, struct page, SPT_elem);
+bool SPT_less(const struct ohash_elem *a, const struct ohash_elem *b,
+              void *aux) {
+  struct page *p_a = ohash_entry(a, struct page, SPT_elem);
+  struct page *p_b = ohash_entry(b, struct page, SPT_elem);
   return p_a->page_addr < p_b->page_addr;
 }
 
-// Function used in SPT_destroy
-void SPT_destructor(struct hash_elem *e, void *aux) {
-  if (e != NULL) {
-    struct page *p = hash_entry(e, struct page, SPT_elem);
-    if (p->frame_addr != NULL && !p->is_swapped) {
-      pagedir_clear_page(thread_current()->pagedir, p->page_addr);
-      if (find_frame(p->frame_addr)) frame_free(p->frame_addr);
-    }
-    free(p);
-  }
+// Function used in SPT_destroy, once frame_release_all() has let go of
+// every page's frame or swap slot.
+void SPT_destructor(struct ohash_elem *e, void *aux) {
+  if (e != NULL) free(ohash_entry(e, struct page, SPT_elem));
 }
 
-void SPT_init() { hash_init(&thread_current()->SPT, SPT_hash, SPT_less, NULL); }
+void SPT_init() {
+  ohash_init(&thread_current()->SPT, SPT_hash, SPT_less, NULL);
+}
 
 struct page *SPT_search(struct thread *owner, void *page_addr) {
   struct page temp;
   temp.page_addr = page_addr;
-  struct hash_elem *e = hash_find(&(owner->SPT), &temp.SPT_elem);
+  struct ohash_elem *e = ohash_find(&(owner->SPT), &temp.SPT_elem);
   if (e != NULL) {
-    struct page *p = hash_entry(e, struct page, SPT_elem);
+    struct page *p = ohash_entry(e, struct page, SPT_elem);
     return p;
   } else {
     return NULL;
   }
 }
 
+struct page *SPT_get(struct thread *owner, void *page_addr) {
+  struct page *p = SPT_search(owner, page_addr);
+  struct vm_area *a;
+  size_t skip, read_bytes = 0;
+
+  if (p != NULL) return p;
+  a = area_find(owner, page_addr);
+  if (a == NULL) return NULL;
+  ASSERT(owner == thread_current());
+
+  skip = (uint8_t *)page_addr - (uint8_t *)a->start;
+  if (skip < a->file_bytes)
+    read_bytes = a->file_bytes - skip < PGSIZE ? a->file_bytes - skip : PGSIZE;
+  p = SPT_insert(a->file, a->ofs + skip, page_addr, NULL, read_bytes,
+                 PGSIZE - read_bytes, a->writable, a->purpose);
+  if (p != NULL && a->purpose == FOR_MMAP)
+    list_push_back(&a->mapping->pages, &p->MMAP_elem);
+  return p;
+}
+
 struct page *SPT_insert(struct file *f, off_t ofs, void *page_addr, void *frame_addr,
                         size_t read_bytes, size_t zero_bytes, bool writable,
                         enum page_purpose purpose) {
   if (SPT_search(thread_current(), page_addr) != NULL) {
     printf("EXIST NO!!!!\n");
-    return;
+    return NULL;
   }
   struct page *p;
   p = malloc(sizeof(struct page));
+  if (p == NULL) return NULL;
   p->page_file = f;
   p->ofs = ofs;
   p->page_addr = page_addr;
   p->frame_addr = frame_addr;
+  p->owner = thread_current();
   p->read_bytes = read_bytes;
   p->zero_bytes = zero_bytes;
   p->is_writable = writable;
+  p->is_cow = false;
+  p->is_prefaulted = false;
+  p->is_pinned = false;
   p->is_swapped = false;
   p->purpose = purpose;
   p->swap_i = BITMAP_ERROR;
 
-  struct frame *frame = find_frame(frame_addr);
-  if (frame) {
-    frame->page_addr = page_addr;
-    frame->is_evictable = true;
-  }
-  hash_insert(&thread_current()->SPT, &p->SPT_elem);
+  frame_map(frame_addr, p);
+  ohash_insert(&thread_current()->SPT, &p->SPT_elem);
   return p;
 }
 
 void SPT_remove(void *page_addr) {
   struct page temp;
   temp.page_addr = page_addr;
-  struct hash_elem *e = hash_delete(&thread_current()->SPT, &temp.SPT_elem);
+  struct ohash_elem *e = ohash_delete(&thread_current()->SPT, &temp.SPT_elem);
   if (e != NULL) {
-    struct page *p = hash_entry(e, struct page, SPT_elem);
+    struct page *p = ohash_entry(e, struct page, SPT_elem);
+    frame_unmap(p);
     free(p);
   }
 }
 
-void SPT_destroy() { hash_destroy(&thread_current()->SPT, SPT_destructor); }
+void SPT_destroy() {
+  // Shared frames stay until their last mapping goes.
+  frame_release_all(thread_current());
+  ohash_destroy(&thread_current()->SPT, SPT_destructor);
+  area_destroy(thread_current());
+}
@@ -1,7 +1,7 @@
 #ifndef PAGE_H
 #define PAGE_H
 
-#include <hash.h>
+#include <ohash.h>
 #include <list.h>
 #include <stddef.h>
 
@@ -27,13 +27,19 @@ This "metadata" includes:
 */
 
 // enums for specifying page's purpose
-enum page_purpose { FOR_FILE = 0, FOR_STACK = 1, FOR_MMAP = 2 };
+// FOR_ANON pages (the sbrk() heap and anonymous mmaps) are demand-zero
+// and go to swap like the stack, but never grow on their own.
+enum page_purpose { FOR_FILE = 0, FOR_STACK = 1, FOR_MMAP = 2, FOR_ANON = 3 };
 
 struct page {
-  void *page_addr;   // upage
-  void *frame_addr;  // kpage
+  void *page_addr;       // upage
+  void *frame_addr;      // kpage
+  struct thread *owner;  // thread whose SPT (and pagedir) holds this page
 
   bool is_writable;  // is writing on this page allowed?
+  bool is_cow;       // writable, but mapped read-only: frame shared by fork.
+  bool is_prefaulted;  // mapped by fault-around, not yet seen accessed.
+  bool is_pinned;    // its frame is pinned by frame_pin().
   size_t swap_i;     // index for swap disk (swapped page end up there)
   bool is_swapped;   // true if this page is in swap_disk, false otherwise.
   enum page_purpose purpose;  // Purpose for this page
@@ -44,8 +50,9 @@ struct page {
   size_t read_bytes;       // size of read bytes.
   size_t zero_bytes;       // size of remaining page (should be zeroed)
 
-  struct hash_elem SPT_elem;  // hash elem for hash SPT
+  struct ohash_elem SPT_elem; // hash elem for hash SPT
   struct list_elem MMAP_elem; // list elem for MMAP mapping
+  struct list_elem rmap_elem; // list elem for the frame's rmap
 };
 
 // Initialize list object named frame_table. Call this in load()!
@@ -54,6 +61,11 @@ void SPT_init();
 // Find page using page address as key.
 struct page *SPT_search(struct thread *owner, void *page_addr);
 
+// Like SPT_search(), but if page_addr has no page yet and lies in one
+// of owner's VM areas (see vm/area.h), creates its page from the area.
+// owner must be the running thread.
+struct page *SPT_get(struct thread *owner, void *page_addr);
+
 // Insert new page "to-do list" into SPT.
 // Arguments are copied from load_segment() in process.c
 struct page *SPT_insert(struct file *f, off_t ofs, void *page_addr, void *frame_addr,
@@ -62,6 +74,9 @@ struct page *SPT_insert(struct file *f, off_t ofs, void *page_addr, void *frame_
 
 void SPT_remove(void *page_addr);
 
+// Tear down the running process's SPT and VM areas, freeing its frames
+// and swap slots. Its page directory must then be destroyed with
+// pagedir_destroy_tables(): the PTEs are left in place.
 void SPT_destroy();
 
 #endif /* vm/page.h */
@@ -0,0 +1,82 @@
+#include "vm/pcache.h"
+
+#include <debug.h>
+#include <hash.h>
+#include <stdio.h>
+
+#include "threads/malloc.h"
+
+// Cached pages, keyed by (inode, ofs, read_bytes).
+static struct ohash cache;
+
+// Statistics.
+static long long lookup_cnt;  // # of lookups.
+static long long hit_cnt;     // # of lookups that found a frame.
+static size_t entry_cnt;      // # of entries right now.
+static size_t peak_cnt;       // highest entry_cnt so far.
+
+static unsigned pcache_hash(const struct ohash_elem* e, void* aux UNUSED) {
+  struct pcache_entry* p = ohash_entry(e, struct pcache_entry, elem);
+  unsigned h = hash_bytes(&p->inode, sizeof p->inode);
+  h = h * 31 + hash_int(p->ofs);
+  return h * 31 + hash_int(p->read_bytes);
+}
+
+static bool pcache_less(const struct ohash_elem* a_,
+                        const struct ohash_elem* b_, void* aux UNUSED) {
+  struct pcache_entry* a = ohash_entry(a_, struct pcache_entry, elem);
+  struct pcache_entry* b = ohash_entry(b_, struct pcache_entry, elem);
+  if (a->inode != b->inode) return a->inode < b->inode;
+  if (a->ofs != b->ofs) return a->ofs < b->ofs;
+  return a->read_bytes < b->read_bytes;
+}
+
+void pcache_init(void) {
+  if (!ohash_init(&cache, pcache_hash, pcache_less, NULL))
+    PANIC("pcache_init: out of memory");
+}
+
+struct pcache_entry* pcache_lookup(struct inode* inode, off_t ofs,
+                                   size_t read_bytes) {
+  struct pcache_entry key;
+  struct ohash_elem* e;
+
+  key.inode = inode;
+  key.ofs = ofs;
+  key.read_bytes = read_bytes;
+  e = ohash_find(&cache, &key.elem);
+
+  lookup_cnt++;
+  if (!e) return NULL;
+  hit_cnt++;
+  return ohash_entry(e, struct pcache_entry, elem);
+}
+
+struct pcache_entry* pcache_insert(struct inode* inode, off_t ofs,
+                                   size_t read_bytes, void* kpage) {
+  struct pcache_entry* p = malloc(sizeof *p);
+  if (!p) return NULL;
+
+  p->inode = inode;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  p->kpage = kpage;
+  if (ohash_insert(&cache, &p->elem) != NULL) {
+    free(p);
+    return NULL;
+  }
+
+  if (++entry_cnt > peak_cnt) peak_cnt = entry_cnt;
+  return p;
+}
+
+void pcache_remove(struct pcache_entry* p) {
+  ohash_delete(&cache, &p->elem);
+  entry_cnt--;
+  free(p);
+}
+
+void pcache_print_stats(void) {
+  printf("Page cache: %lld/%lld lookups hit, %zu pages cached (peak %zu)\n",
+         hit_cnt, lookup_cnt, entry_cnt, peak_cnt);
+}
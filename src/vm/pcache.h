@@ -0,0 +1,46 @@
+#ifndef PCACHE_H
+#define PCACHE_H
+
+#include <ohash.h>
+#include <stddef.h>
+
+#include "filesys/off_t.h"
+
+// Page cache: frames holding file contents, keyed by (inode, offset).
+//
+// A frame in the cache can be mapped by any number of processes; its
+// rmap (see vm/frame.h) lists them. The entry lives exactly as long as
+// its frame: it is removed when the frame is evicted or when its last
+// mapper goes away.
+//
+// The cache is protected by frame_lock, so call these from vm/frame.c.
+
+struct inode;
+
+struct pcache_entry {
+  struct inode* inode;  // file the page came from...
+  off_t ofs;            // ...at this offset,
+  size_t read_bytes;    // reading this many bytes (rest is zero).
+  void* kpage;          // frame holding the page.
+
+  struct ohash_elem elem;  // hash elem for the cache.
+};
+
+void pcache_init(void);
+
+// Find the entry for (inode, ofs, read_bytes). NULL on miss.
+struct pcache_entry* pcache_lookup(struct inode* inode, off_t ofs,
+                                   size_t read_bytes);
+
+// Add an entry for kpage. Returns NULL if the key is already cached
+// (or out of memory), in which case kpage stays private.
+struct pcache_entry* pcache_insert(struct inode* inode, off_t ofs,
+                                   size_t read_bytes, void* kpage);
+
+// Remove and free entry e.
+void pcache_remove(struct pcache_entry* e);
+
+// Print hit and sharing statistics.
+void pcache_print_stats(void);
+
+#endif /* vm/pcache.h */
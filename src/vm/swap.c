@@ -1,75 +1,460 @@
 #include "vm/swap.h"
 
 #include <debug.h>
+#include <round.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "devices/timer.h"
 #include "lib/kernel/bitmap.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/synch.h"
+#include "vm/zswap.h"
 
 #define SEC_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
-#define FREE false
-#define FILLED true
 
-// Swap disk.
-static struct block *swap_disk;
+// No slot / end of the extent list.
+#define NO_SLOT BITMAP_ERROR
 
-// Mapping of swap disk. false: empty, true: filled.
-static struct bitmap *disk_map;
+// Swap space is made of up to SD_DEV_MAX devices. Each is divided into
+// page-sized slots, and slot numbers run on from one device to the next,
+// so a slot index names both a device and a place on it. A slot is free
+// iff its ref_cnt is 0. Runs of free slots on a device form extents,
+// which are kept in a per-device doubly linked list threaded through the
+// slots themselves: the first and last slot of an extent both record
+// its length (a boundary tag), and the first slot holds the list links.
+// Allocation takes from the front of an extent and freeing merges with
+// the extents on either side, so both are O(1) apart from the first-fit
+// search for runs.
+struct slot {
+  uint16_t ref_cnt;  // # of pages sharing this slot. 0: free.
+  size_t ext_len;    // free extent length. (first & last slot only)
+  size_t next;       // next free extent. (first slot only)
+  size_t prev;       // previous free extent. (first slot only)
+};
 
-// Lock.
+// A swap device. Slots go to the devices of the highest priority that
+// have room; a batch is striped across all devices of that priority.
+// Transfers run under the device's own io_lock, not swap_lock, so that
+// devices on different channels transfer at the same time.
+struct swap_dev {
+  struct block *block;
+  int prio;             // higher is used first.
+  size_t base;          // first slot.
+  size_t slot_cnt;      // # of slots.
+  size_t free_cnt;      // # of free slots.
+  size_t free_head;     // first free extent.
+  size_t extent_cnt;    // # of free extents.
+  struct lock io_lock;  // held during a transfer.
+
+  // Statistics for swap-in and swap-out. (protected by io_lock)
+  long long read_cnt;        // # of pages read.
+  long long write_cnt;       // # of block_writev() transfers.
+  long long write_page_cnt;  // # of pages they carried.
+  size_t max_batch;          // largest # of pages in one transfer.
+  int64_t write_ticks;       // timer ticks spent writing.
+};
+
+// Swap devices, by decreasing priority once SD_init() has run.
+static struct swap_dev devs[SD_DEV_MAX];
+static size_t dev_cnt;
+static size_t rotor;  // next device to stripe to, among equals.
+
+// Slots of all devices.
+static struct slot *slots;
+static size_t slot_cnt;
+
+// Lock for slots and free extents. Taken before a device's io_lock,
+// never while holding one.
 static struct lock swap_lock;
 
-void SD_init() {
-  swap_disk = block_get_role(BLOCK_SWAP);
-  if (!swap_disk) {
+// Statistics for swap usage.
+static size_t used_cnt;    // # of slots in use.
+static size_t peak_cnt;    // highest used_cnt so far.
+
+// Returns the device that slot idx is on.
+static struct swap_dev *slot_dev(size_t idx) {
+  size_t i;
+
+  for (i = 0; i < dev_cnt; i++)
+    if (idx < devs[i].base + devs[i].slot_cnt) return &devs[i];
+  NOT_REACHED();
+}
+
+// Makes the free extent [start, start + len) on d and puts it on the
+// list.
+static void extent_insert(struct swap_dev *d, size_t start, size_t len) {
+  slots[start].ext_len = slots[start + len - 1].ext_len = len;
+  slots[start].prev = NO_SLOT;
+  slots[start].next = d->free_head;
+  if (d->free_head != NO_SLOT) slots[d->free_head].prev = start;
+  d->free_head = start;
+  d->extent_cnt++;
+}
+
+// Takes the free extent starting at start off d's list.
+static void extent_remove(struct swap_dev *d, size_t start) {
+  struct slot *s = &slots[start];
+  if (s->prev != NO_SLOT)
+    slots[s->prev].next = s->next;
+  else
+    d->free_head = s->next;
+  if (s->next != NO_SLOT) slots[s->next].prev = s->prev;
+  d->extent_cnt--;
+}
+
+static void write_slot(size_t idx, const void *page);
+
+bool SD_add_device(struct block *block, int prio) {
+  size_t i;
+
+  if (dev_cnt == SD_DEV_MAX) return false;
+  for (i = 0; i < dev_cnt; i++)
+    if (devs[i].block == block) return false;
+  devs[dev_cnt].block = block;
+  devs[dev_cnt].prio = prio;
+  dev_cnt++;
+  return true;
+}
+
+void SD_init(size_t zswap_page_cnt) {
+  size_t i, j;
+
+  lock_init(&swap_lock);
+
+  if (dev_cnt == 0) {
     printf("swap.c: Swap disk does not exist.\n");
     return;
   }
 
-  size_t dsk_size = block_size(swap_disk);
+  // Sort by decreasing priority (insertion sort: there are only a
+  // few), keeping the given order among equals.
+  for (i = 1; i < dev_cnt; i++) {
+    struct swap_dev d = devs[i];
+    for (j = i; j > 0 && devs[j - 1].prio < d.prio; j--) devs[j] = devs[j - 1];
+    devs[j] = d;
+  }
+
+  for (i = 0; i < dev_cnt; i++) {
+    struct swap_dev *d = &devs[i];
+    d->base = slot_cnt;
+    d->slot_cnt = block_size(d->block) / SEC_PER_PAGE;
+    d->free_head = NO_SLOT;
+    lock_init(&d->io_lock);
+    slot_cnt += d->slot_cnt;
+  }
 
-  disk_map = bitmap_create(dsk_size);
-  if (!disk_map) {
-    printf("swap.c: bitmap init failed.\n");
+  slots = calloc(slot_cnt, sizeof *slots);
+  if (!slots) {
+    printf("swap.c: slot table init failed.\n");
+    slot_cnt = 0;
+    dev_cnt = 0;
     return;
   }
-  lock_init(&swap_lock);
+  for (i = 0; i < dev_cnt; i++) {
+    struct swap_dev *d = &devs[i];
+    if (d->slot_cnt > 0) extent_insert(d, d->base, d->slot_cnt);
+    d->free_cnt = d->slot_cnt;
+  }
+  if (slot_cnt > 0 && zswap_page_cnt > 0)
+    zswap_init(zswap_page_cnt, slot_cnt, write_slot);
+}
+
+// Allocates cnt contiguous slots on d, first fit, each with one
+// reference. Returns the first slot, or NO_SLOT. (call this with
+// swap_lock!)
+static size_t alloc_run(struct swap_dev *d, size_t cnt) {
+  size_t start, len, i;
+
+  for (start = d->free_head; start != NO_SLOT; start = slots[start].next)
+    if (slots[start].ext_len >= cnt) break;
+  if (start == NO_SLOT) return NO_SLOT;
+
+  // Carve the run off the front of the extent.
+  len = slots[start].ext_len;
+  extent_remove(d, start);
+  if (len > cnt) extent_insert(d, start + cnt, len - cnt);
+
+  for (i = start; i < start + cnt; i++) slots[i].ref_cnt = 1;
+  d->free_cnt -= cnt;
+  used_cnt += cnt;
+  if (used_cnt > peak_cnt) peak_cnt = used_cnt;
+  return start;
+}
+
+// Drops one reference to slot idx, freeing it when none are left.
+// (call this with swap_lock!)
+static void put_slot(size_t idx) {
+  struct swap_dev *d;
+  size_t start = idx, len = 1;
+
+  ASSERT(idx < slot_cnt);
+  ASSERT(slots[idx].ref_cnt > 0);
+  if (--slots[idx].ref_cnt > 0) return;
+  d = slot_dev(idx);
+  d->free_cnt++;
+  used_cnt--;
+  zswap_invalidate(idx);
+
+  // Merge with the free extent that ends just before idx...
+  if (idx > d->base && slots[idx - 1].ref_cnt == 0) {
+    size_t left_len = slots[idx - 1].ext_len;
+    start = idx - left_len;
+    len += left_len;
+    extent_remove(d, start);
+  }
+  // ...and with the one that starts just after it, on the same device.
+  if (idx + 1 < d->base + d->slot_cnt && slots[idx + 1].ref_cnt == 0) {
+    len += slots[idx + 1].ext_len;
+    extent_remove(d, idx + 1);
+  }
+  extent_insert(d, start, len);
+}
+
+// Returns the device to put the next stripe on: the next one after the
+// rotor among the highest-priority devices that have a free slot, or
+// NULL if swap is full. *group_cnt gets the number of such devices.
+// (call this with swap_lock!)
+static struct swap_dev *next_dev(size_t *group_cnt) {
+  struct swap_dev *pick = NULL;
+  size_t i, n = 0;
+  int prio = 0;
+
+  for (i = 0; i < dev_cnt; i++) {
+    struct swap_dev *d = &devs[(rotor + i) % dev_cnt];
+    if (d->free_cnt == 0) continue;
+    if (pick == NULL || d->prio > prio) {
+      pick = d;
+      prio = d->prio;
+      n = 0;
+    }
+    if (d->prio == prio) n++;
+  }
+  if (pick != NULL) rotor = (pick - devs + 1) % dev_cnt;
+  *group_cnt = n;
+  return pick;
+}
+
+// Points sectors[] at the SEC_PER_PAGE sectors of page.
+static void page_sectors(void *page, void **sectors) {
+  size_t i;
+  for (i = 0; i < SEC_PER_PAGE; i++)
+    sectors[i] = (uint8_t *)page + BLOCK_SECTOR_SIZE * i;
 }
 
 void SD_read(size_t idx, void *page) {
+  void *sectors[SEC_PER_PAGE];
+  struct swap_dev *d;
+
   lock_acquire(&swap_lock);
-  if (idx == BITMAP_ERROR)
+  if (idx == NO_SLOT)
     PANIC("BUG: SD_read called with BITMAP_ERROR. frame addr: %p\n", page);
-  ASSERT(!bitmap_contains(disk_map, idx, SEC_PER_PAGE, FREE));
+  ASSERT(idx < slot_cnt && slots[idx].ref_cnt > 0);
 
   // printf("SD_read is reading idx: %zu\n", idx);
-  size_t i;
-  for (i = idx; i < idx + SEC_PER_PAGE; i++) {
-    block_read(swap_disk, i, page + BLOCK_SECTOR_SIZE * (i - idx));
+  if (zswap_load(idx, page)) {
+    put_slot(idx);
+    lock_release(&swap_lock);
+    return;
   }
-  if (idx != 0) bitmap_set_multiple(disk_map, idx, SEC_PER_PAGE, FREE);
   lock_release(&swap_lock);
+
+  // Our reference keeps the slot from being freed and reused meanwhile.
+  d = slot_dev(idx);
+  page_sectors(page, sectors);
+  lock_acquire(&d->io_lock);
+  block_readv(d->block, (idx - d->base) * SEC_PER_PAGE, sectors,
+              SEC_PER_PAGE);
+  d->read_cnt++;
+  lock_release(&d->io_lock);
+
+  lock_acquire(&swap_lock);
+  put_slot(idx);
+  lock_release(&swap_lock);
+}
+
+// Writes pages[0..cnt) to the consecutive slots starting at idx, all on
+// one device, as one transfer.
+static void write_run(size_t idx, const void *const *pages, size_t cnt) {
+  const void *sectors[SD_BATCH_MAX * SEC_PER_PAGE];
+  struct swap_dev *d = slot_dev(idx);
+  size_t i;
+
+  ASSERT(cnt <= SD_BATCH_MAX);
+  ASSERT(idx + cnt <= d->base + d->slot_cnt);
+  for (i = 0; i < cnt; i++)
+    page_sectors((void *)pages[i], (void **)sectors + i * SEC_PER_PAGE);
+
+  lock_acquire(&d->io_lock);
+  int64_t begin = timer_ticks();
+  block_writev(d->block, (idx - d->base) * SEC_PER_PAGE, sectors,
+               cnt * SEC_PER_PAGE);
+  d->write_ticks += timer_elapsed(begin);
+
+  d->write_cnt++;
+  d->write_page_cnt += cnt;
+  if (cnt > d->max_batch) d->max_batch = cnt;
+  lock_release(&d->io_lock);
+}
+
+// zswap writeback: page goes to slot idx on the disk.
+static void write_slot(size_t idx, const void *page) {
+  write_run(idx, &page, 1);
 }
 
 size_t SD_write(void *page) {
   size_t idx;
+  SD_write_batch(&page, 1, &idx);
+  return idx;
+}
+
+void SD_write_batch(void **pages, size_t cnt, size_t *idx) {
+  // Runs that go to the disk, written once swap_lock is released.
+  size_t run_slot[SD_BATCH_MAX];
+  size_t run_page[SD_BATCH_MAX];
+  size_t run_len[SD_BATCH_MAX];
+  size_t run_cnt = 0;
+  size_t stripe = 0;
+  size_t done = 0;
+  size_t i;
+
+  ASSERT(cnt <= SD_BATCH_MAX);
+
   lock_acquire(&swap_lock);
-  idx = bitmap_scan_and_flip(disk_map, 0, SEC_PER_PAGE, FREE);
-  // printf("bitmap_scan_and_flip returned: %zu\n", idx);
-  if (idx == BITMAP_ERROR) {
-    // printf("Somehow, you fucked up. idx=%zu\n", idx);
-    return idx;
+  while (done < cnt) {
+    // Take the longest contiguous run of slots on the next device, up
+    // to a stripe's worth, halving the request until it fits.
+    size_t group_cnt;
+    struct swap_dev *d = next_dev(&group_cnt);
+    size_t run, start = NO_SLOT;
+
+    if (d == NULL) {
+      // Swap is full.
+      for (; done < cnt; done++) idx[done] = NO_SLOT;
+      break;
+    }
+    // Equal shares for the devices the batch is striped across.
+    if (stripe == 0) stripe = DIV_ROUND_UP(cnt, group_cnt);
+    run = cnt - done < stripe ? cnt - done : stripe;
+    while (run > 0) {
+      start = alloc_run(d, run);
+      if (start != NO_SLOT) break;
+      run /= 2;
+    }
+    ASSERT(start != NO_SLOT);
+
+    // Pages that zswap takes stay in memory; the rest of the run goes
+    // out in as few transfers as the gaps between them allow.
+    size_t disk_start = 0;
+    for (i = 0; i <= run; i++) {
+      if (i < run) {
+        idx[done + i] = start + i;
+        if (!zswap_store(start + i, pages[done + i])) continue;
+      }
+      if (i > disk_start) {
+        run_slot[run_cnt] = start + disk_start;
+        run_page[run_cnt] = done + disk_start;
+        run_len[run_cnt] = i - disk_start;
+        run_cnt++;
+      }
+      disk_start = i + 1;
+    }
+    done += run;
   }
+  lock_release(&swap_lock);
 
+  // Nobody else knows the new slots yet, so they can be written
+  // without swap_lock.
+  for (i = 0; i < run_cnt; i++)
+    write_run(run_slot[i], (const void *const *)pages + run_page[i],
+              run_len[i]);
+}
+
+void SD_dup(size_t idx) {
+  if (idx == NO_SLOT) return;
+  lock_acquire(&swap_lock);
+  ASSERT(idx < slot_cnt && slots[idx].ref_cnt > 0);
+  ASSERT(slots[idx].ref_cnt < UINT16_MAX);
+  slots[idx].ref_cnt++;
+  lock_release(&swap_lock);
+}
+
+void SD_free(size_t idx) {
+  if (idx == NO_SLOT) return;
+  lock_acquire(&swap_lock);
+  put_slot(idx);
+  lock_release(&swap_lock);
+}
+
+void SD_free_batch(const size_t *idx, size_t cnt) {
   size_t i;
-  for (i = idx; i < idx + SEC_PER_PAGE; i++) {
-    block_write(swap_disk, i, page + BLOCK_SECTOR_SIZE * (i - idx));
+
+  lock_acquire(&swap_lock);
+  for (i = 0; i < cnt; i++)
+    if (idx[i] != NO_SLOT) put_slot(idx[i]);
+  lock_release(&swap_lock);
+}
+
+void SD_get_stats(struct memstat_swap *stats) {
+  size_t e, i;
+
+  lock_acquire(&swap_lock);
+  stats->slot_cnt = slot_cnt;
+  stats->used_cnt = used_cnt;
+  stats->peak_cnt = peak_cnt;
+  stats->free_extent_cnt = 0;
+  stats->largest_free_run = 0;
+  for (i = 0; i < dev_cnt; i++) {
+    stats->free_extent_cnt += devs[i].extent_cnt;
+    for (e = devs[i].free_head; e != NO_SLOT; e = slots[e].next)
+      if (slots[e].ext_len > stats->largest_free_run)
+        stats->largest_free_run = slots[e].ext_len;
   }
   lock_release(&swap_lock);
+}
 
-  return idx;
+void SD_print_stats(void) {
+  struct memstat_swap usage;
+  long long write_cnt = 0, write_page_cnt = 0;
+  int64_t write_ticks = 0;
+  size_t max_batch = 0;
+  size_t free_cnt, i;
+
+  // SD_write_batch() writes the stripes one device after another, from
+  // one thread, so the devices' write times add up.
+  for (i = 0; i < dev_cnt; i++) {
+    struct swap_dev *d = &devs[i];
+    write_cnt += d->write_cnt;
+    write_page_cnt += d->write_page_cnt;
+    write_ticks += d->write_ticks;
+    if (d->max_batch > max_batch) max_batch = d->max_batch;
+  }
+  long long avg_x100 = write_cnt ? write_page_cnt * 100 / write_cnt : 0;
+  long long pps = write_ticks ? write_page_cnt * TIMER_FREQ / write_ticks : 0;
+
+  SD_get_stats(&usage);
+  free_cnt = usage.slot_cnt - usage.used_cnt;
+
+  // Fragmentation: share of free slots outside the largest free extent.
+  printf("Swap: %zu/%zu slots used (peak %zu), %zu free extents, "
+         "%zu%% fragmented\n",
+         usage.used_cnt, usage.slot_cnt, usage.peak_cnt,
+         usage.free_extent_cnt,
+         free_cnt ? (free_cnt - usage.largest_free_run) * 100 / free_cnt : 0);
+  printf("Swap: %lld pages out in %lld writes (avg batch %lld.%02lld, "
+         "max %zu), %lld pages/s\n",
+         write_page_cnt, write_cnt, avg_x100 / 100, avg_x100 % 100,
+         max_batch, pps);
+  if (dev_cnt > 1)
+    for (i = 0; i < dev_cnt; i++)
+      printf("Swap: %s (priority %d): %zu/%zu slots used, %lld pages out, "
+             "%lld pages in\n",
+             block_name(devs[i].block), devs[i].prio,
+             devs[i].slot_cnt - devs[i].free_cnt, devs[i].slot_cnt,
+             devs[i].write_page_cnt, devs[i].read_cnt);
+  zswap_print_stats();
 }
@@ -1,16 +1,62 @@
 #ifndef SWAP_H
 #define SWAP_H
+#include <memstat.h>
+#include <stdbool.h>
 #include <stddef.h>
 
 #include "devices/block.h"
 
-void SD_init();
+// Swap indices name page-sized slots of the swap disk. Each slot has a
+// reference count, so that several pages can share one copy.
+//
+// The swap disk may be several block devices, each with a priority.
+// Swap-out fills the devices of the highest priority first, striping
+// each batch across all devices of that priority, whose transfers then
+// run in parallel if the devices are on different channels.
 
-// Read PGSIZE bytes of data from the swap_disk to page
+// Most swap devices.
+#define SD_DEV_MAX 4
+
+// Add block as a swap device of priority prio (higher is used first).
+// Call this before SD_init(). Returns false if there are SD_DEV_MAX
+// devices already or block is one of them.
+bool SD_add_device(struct block* block, int prio);
+
+// Set up the swap devices, fronted by a zswap arena of zswap_page_cnt
+// kernel pages (0: no zswap).
+void SD_init(size_t zswap_page_cnt);
+
+// Read PGSIZE bytes of data from the swap_disk to page,
+// and drop the caller's reference to slot idx.
 void SD_read(size_t idx, void* page);
 
 // Write PGSIZE bytes of data from the page to the swap_disk,
 // with corresponding index.
 size_t SD_write(void* page);
 
+// Most pages SD_write_batch() accepts at once.
+#define SD_BATCH_MAX 8
+
+// Write cnt pages to the swap disk, storing each page's index in idx[]
+// (BITMAP_ERROR if swap is full). Pages are given contiguous slots where
+// possible, so that each run goes to the disk as one transfer.
+void SD_write_batch(void** pages, size_t cnt, size_t* idx);
+
+// Add a reference to slot idx, for a page that shares its contents.
+void SD_dup(size_t idx);
+
+// Drop a reference to slot idx without reading it.
+void SD_free(size_t idx);
+
+// Same as SD_free() for each of the cnt slots in idx[], taking the swap
+// lock once.
+void SD_free_batch(const size_t* idx, size_t cnt);
+
+// Store swap usage into stats.
+void SD_get_stats(struct memstat_swap* stats);
+
+// Print swap usage, fragmentation, and batch size and throughput of
+// swap-out.
+void SD_print_stats(void);
+
 #endif /* vm/swap.h */
@@ -0,0 +1,244 @@
+#include "vm/zswap.h"
+
+#include <debug.h>
+#include <list.h>
+#include <lz.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+// The arena is managed zbud-style: each arena page holds at most two
+// compressed pages, one packed against its start ("first") and one
+// against its end ("last"). Space is counted in CHUNK_SIZE chunks, and
+// pages with one free buddy are kept on a list per number of free
+// chunks, so finding room for an object is a short walk over lists.
+#define CHUNK_SHIFT 6
+#define CHUNK_SIZE (1 << CHUNK_SHIFT)
+#define NCHUNKS (PGSIZE >> CHUNK_SHIFT)
+
+// Pages that compress worse than this go straight to the disk.
+#define MAX_STORE_SIZE (PGSIZE * 3 / 4)
+
+// One page of the arena.
+struct zpage {
+  uint8_t* base;             // kernel page.
+  size_t first_chunks;       // chunks used by the first buddy, 0 if free.
+  size_t last_chunks;        // chunks used by the last buddy, 0 if free.
+  struct list_elem elem;     // in unbuddied[] or empty_pages.
+};
+
+// One cached page.
+struct zswap_entry {
+  size_t slot;               // swap slot this is the contents of.
+  struct zpage* zpage;       // arena page holding it...
+  bool is_last;              // ...in its last buddy, or its first.
+  size_t size;               // compressed size in bytes.
+  struct list_elem lru_elem; // in lru, most recently used at the back.
+};
+
+static struct zpage* zpages;
+static size_t zpage_cnt;
+static struct list unbuddied[NCHUNKS];  // by number of free chunks.
+static struct list empty_pages;
+
+static struct zswap_entry** entries;  // by slot, NULL if not cached.
+static size_t entry_slot_cnt;
+static struct list lru;
+
+static void (*writeback_fn)(size_t slot, const void* page);
+
+// Scratch space. swap_lock serializes every user.
+static uint8_t work[LZ_WORK_SIZE];
+static uint8_t cbuf[PGSIZE];
+static uint8_t bounce[PGSIZE];
+
+// Statistics.
+static long long store_cnt;      // # of pages stored.
+static long long reject_cnt;     // # of pages that did not compress enough.
+static long long hit_cnt;        // # of swap-ins served from the cache.
+static long long miss_cnt;       // # of swap-ins that went to the disk.
+static long long writeback_cnt;  // # of entries written back to the disk.
+static long long in_bytes;       // bytes of stored pages before...
+static long long out_bytes;      // ...and after compression.
+
+void zswap_init(size_t page_cnt, size_t slot_cnt,
+                void (*writeback)(size_t slot, const void* page)) {
+  size_t i;
+
+  for (i = 0; i < NCHUNKS; i++) list_init(&unbuddied[i]);
+  list_init(&empty_pages);
+  list_init(&lru);
+  writeback_fn = writeback;
+
+  zpages = calloc(page_cnt, sizeof *zpages);
+  entries = calloc(slot_cnt, sizeof *entries);
+  if (!zpages || !entries) {
+    printf("zswap: out of memory, disabled.\n");
+    free(zpages);
+    free(entries);
+    zpages = NULL;
+    entries = NULL;
+    return;
+  }
+  entry_slot_cnt = slot_cnt;
+
+  // Take what the kernel pool can spare, up to page_cnt pages.
+  for (zpage_cnt = 0; zpage_cnt < page_cnt; zpage_cnt++) {
+    struct zpage* z = &zpages[zpage_cnt];
+    z->base = palloc_get_page(PAL_VM);
+    if (!z->base) break;
+    list_push_back(&empty_pages, &z->elem);
+  }
+  printf("zswap: %zu page arena.\n", zpage_cnt);
+}
+
+// Files zpage Z on the list matching its free space, or none if full.
+static void zpage_file(struct zpage* z) {
+  if (z->first_chunks == 0 && z->last_chunks == 0)
+    list_push_back(&empty_pages, &z->elem);
+  else if (z->first_chunks == 0 || z->last_chunks == 0)
+    list_push_back(&unbuddied[NCHUNKS - z->first_chunks - z->last_chunks],
+                   &z->elem);
+}
+
+// Finds room for CHUNKS chunks and records them in entry E.
+// Returns false if no arena page has that much room.
+static bool zpage_alloc(struct zswap_entry* e, size_t chunks) {
+  struct zpage* z = NULL;
+  size_t i;
+
+  for (i = chunks; i < NCHUNKS && !z; i++)
+    if (!list_empty(&unbuddied[i]))
+      z = list_entry(list_pop_front(&unbuddied[i]), struct zpage, elem);
+  if (!z && !list_empty(&empty_pages))
+    z = list_entry(list_pop_front(&empty_pages), struct zpage, elem);
+  if (!z) return false;
+
+  if (z->first_chunks == 0) {
+    z->first_chunks = chunks;
+    e->is_last = false;
+  } else {
+    z->last_chunks = chunks;
+    e->is_last = true;
+  }
+  e->zpage = z;
+  zpage_file(z);
+  return true;
+}
+
+// Returns where entry E's compressed bytes live.
+static uint8_t* entry_data(struct zswap_entry* e) {
+  struct zpage* z = e->zpage;
+  return e->is_last ? z->base + PGSIZE - z->last_chunks * CHUNK_SIZE
+                    : z->base;
+}
+
+// Frees entry E and its arena space.
+static void entry_free(struct zswap_entry* e) {
+  struct zpage* z = e->zpage;
+  bool was_full = z->first_chunks != 0 && z->last_chunks != 0;
+
+  if (!was_full) list_remove(&z->elem);
+  if (e->is_last)
+    z->last_chunks = 0;
+  else
+    z->first_chunks = 0;
+  zpage_file(z);
+
+  list_remove(&e->lru_elem);
+  entries[e->slot] = NULL;
+  in_bytes -= PGSIZE;
+  out_bytes -= e->size;
+  free(e);
+}
+
+// Writes the least recently used entry back to the disk and frees it.
+// Returns false if the cache is empty.
+static bool evict_lru(void) {
+  struct zswap_entry* e;
+
+  if (list_empty(&lru)) return false;
+  e = list_entry(list_front(&lru), struct zswap_entry, lru_elem);
+  if (lz_decompress(entry_data(e), e->size, bounce, PGSIZE) != PGSIZE)
+    PANIC("zswap: corrupt entry for slot %zu", e->slot);
+  writeback_fn(e->slot, bounce);
+  writeback_cnt++;
+  entry_free(e);
+  return true;
+}
+
+bool zswap_store(size_t slot, const void* page) {
+  struct zswap_entry* e;
+  size_t size, chunks;
+
+  if (zpage_cnt == 0) return false;
+  ASSERT(slot < entry_slot_cnt && entries[slot] == NULL);
+
+  size = lz_compress(page, PGSIZE, cbuf, MAX_STORE_SIZE, work);
+  if (size == 0) {
+    reject_cnt++;
+    return false;
+  }
+  chunks = DIV_ROUND_UP(size, CHUNK_SIZE);
+
+  e = malloc(sizeof *e);
+  if (!e) return false;
+  while (!zpage_alloc(e, chunks))
+    if (!evict_lru()) {
+      free(e);
+      return false;
+    }
+
+  e->slot = slot;
+  e->size = size;
+  memcpy(entry_data(e), cbuf, size);
+  list_push_back(&lru, &e->lru_elem);
+  entries[slot] = e;
+
+  store_cnt++;
+  in_bytes += PGSIZE;
+  out_bytes += size;
+  return true;
+}
+
+bool zswap_load(size_t slot, void* page) {
+  struct zswap_entry* e;
+
+  if (zpage_cnt == 0) return false;
+  ASSERT(slot < entry_slot_cnt);
+
+  e = entries[slot];
+  if (!e) {
+    miss_cnt++;
+    return false;
+  }
+  if (lz_decompress(entry_data(e), e->size, page, PGSIZE) != PGSIZE)
+    PANIC("zswap: corrupt entry for slot %zu", slot);
+  list_remove(&e->lru_elem);
+  list_push_back(&lru, &e->lru_elem);
+  hit_cnt++;
+  return true;
+}
+
+void zswap_invalidate(size_t slot) {
+  if (zpage_cnt == 0) return;
+  ASSERT(slot < entry_slot_cnt);
+  if (entries[slot]) entry_free(entries[slot]);
+}
+
+void zswap_print_stats(void) {
+  long long loads = hit_cnt + miss_cnt;
+
+  if (zpage_cnt == 0) return;
+  printf("zswap: %lld stored, %lld rejected, %lld written back; "
+         "ratio %lld%% (%lld/%lld bytes held); "
+         "%lld/%lld swap-ins hit (%lld%%)\n",
+         store_cnt, reject_cnt, writeback_cnt,
+         in_bytes ? out_bytes * 100 / in_bytes : 0, out_bytes, in_bytes,
+         hit_cnt, loads, loads ? hit_cnt * 100 / loads : 0);
+}
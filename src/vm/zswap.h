@@ -0,0 +1,39 @@
+#ifndef ZSWAP_H
+#define ZSWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Compressed swap cache.
+//
+// zswap sits in front of the swap disk: a page swapped out to slot i is
+// compressed (lib/kernel/lz.c) and kept in a bounded arena of kernel
+// pages, and only reaches the disk when the arena fills up and it is
+// the least recently used entry. Swap-in checks the cache first.
+//
+// Entries are keyed by swap slot, so a cached page still owns its slot
+// and swap.c's slot allocator and reference counts work unchanged.
+//
+// zswap has no lock of its own: swap.c calls every function below with
+// swap_lock held.
+
+// Use page_cnt kernel pages as the arena, for a swap disk of slot_cnt
+// slots. writeback() writes an evicted page to its slot on the disk.
+void zswap_init(size_t page_cnt, size_t slot_cnt,
+                void (*writeback)(size_t slot, const void* page));
+
+// Compress page into the cache as the contents of slot.
+// Returns false if zswap is off or the page does not compress well,
+// in which case the caller writes it to the disk itself.
+bool zswap_store(size_t slot, const void* page);
+
+// Copy the contents of slot into page if cached. Returns false on miss.
+bool zswap_load(size_t slot, void* page);
+
+// Drop the cached copy of slot, if any. (Call this when it is freed.)
+void zswap_invalidate(size_t slot);
+
+// Print compression ratio, hit rate and writebacks.
+void zswap_print_stats(void);
+
+#endif /* vm/zswap.h */